@@ -1,6 +1,13 @@
 org 0x7C00
 bits 16
 
+MEMORY_MAP_COUNT_ADDR equ 0x4FF0
+MEMORY_MAP_ADDR equ 0x5000
+MEMORY_MAP_MAX equ 32
+
+KERNEL_SECTORS equ 256          ; 内核最大 128KB
+SECTORS_PER_READ equ 64
+
 start:
     ; 初始化段寄存器
     xor ax, ax
@@ -13,19 +20,47 @@ start:
     mov si, msg_loading
     call print_string
 
-    ; 加载内核到 0x10000
-    mov ax, 0x1000
-    mov es, ax
-    xor bx, bx
-    
-    mov ah, 0x02    ; 读扇区
-    mov al, 64      ; 64个扇区
-    mov ch, 0       ; 柱面0
-    mov cl, 2       ; 扇区2
-    mov dh, 0       ; 磁头0
+    ; 通过 int 0x15, eax=0xE820 获取内存布局，条目保存到 0x5000，数量保存到 0x4FF0
+    mov di, MEMORY_MAP_ADDR
+    xor ebx, ebx
+    xor bp, bp
+.e820_loop:
+    mov eax, 0xE820
+    mov edx, 0x534D4150         ; 'SMAP'
+    mov ecx, 24
+    mov dword [es:di + 20], 1   ; 默认 ACPI 扩展属性有效
+    int 0x15
+    jc .e820_done               ; 不支持或已结束
+    cmp eax, 0x534D4150
+    jne .e820_done
+
+    mov ecx, [es:di + 8]        ; 跳过长度为 0 的条目
+    or ecx, [es:di + 12]
+    jz .e820_next
+
+    inc bp
+    add di, 24
+    cmp bp, MEMORY_MAP_MAX
+    jae .e820_done
+.e820_next:
+    test ebx, ebx
+    jnz .e820_loop
+.e820_done:
+    mov [MEMORY_MAP_COUNT_ADDR], bp
+
+    ; 用 LBA 扩展读 (int 0x13, ah=0x42) 分块加载内核到 0x10000
+    mov cx, KERNEL_SECTORS / SECTORS_PER_READ
+.load_loop:
+    push cx
+    mov si, disk_packet
+    mov ah, 0x42
     mov dl, 0x80    ; 驱动器
     int 0x13
     jc disk_error
+    add word [disk_packet + 6], SECTORS_PER_READ * 512 / 16    ; 段地址前进
+    add dword [disk_packet + 8], SECTORS_PER_READ              ; LBA 前进
+    pop cx
+    loop .load_loop
 
     ; 切换到保护模式
     cli
@@ -72,6 +107,15 @@ init_pm:
 msg_loading db "Booting...", 0xD, 0xA, 0
 msg_error db "Disk error!", 0
 
+; LBA 磁盘地址包
+disk_packet:
+    db 0x10                 ; 包大小
+    db 0
+    dw SECTORS_PER_READ     ; 扇区数
+    dw 0                    ; 缓冲区偏移
+    dw 0x1000               ; 缓冲区段
+    dq 1                    ; 起始 LBA（第 2 个扇区）
+
 ; GDT
 gdt_start:
     dq 0
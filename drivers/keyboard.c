@@ -1,7 +1,9 @@
 #include "keyboard.h"
 #include "stdio.h"
+#include "softirq.h"
 
 #define INPUT_BUFFER_SIZE 256
+#define SCANCODE_RING_SIZE 64   // 2 的幂，中断上下文与下半部之间的扫描码缓冲
 
 static const char keyboard_map[128] = {
     0,  27, '1', '2', '3', '4', '5', '6', '7', '8', '9', '0', '-', '=', '\b',
@@ -15,37 +17,67 @@ static const char keyboard_map[128] = {
 static char input_buffer[INPUT_BUFFER_SIZE];
 static uint32_t buffer_index = 0;
 
+/* 中断处理只写 head，下半部只写 tail */
+static volatile uint8_t scancode_ring[SCANCODE_RING_SIZE];
+static volatile uint32_t ring_head = 0;
+static volatile uint32_t ring_tail = 0;
+static uint32_t ring_dropped = 0;
+
+static void keyboard_bottom_half(void* data);
+static struct tasklet keyboard_tasklet = TASKLET_INIT(keyboard_bottom_half, NULL);
+
 void keyboard_init()
 {
     // printf("Initializing keyboard...\n");
 
-    uint8_t current_mask = inb(0x21);
-
-    outb(0x21, current_mask & 0xFD);
+    irq_unmask(1);
 
     printf("Keyboard initialized (IRQ1 enabled)\n");
 }
 
-void keyboard_interrupt_handler()
+void keyboard_interrupt_handler(struct interrupt_frame* frame, void* ctx)
 {
+    (void)frame;
+    (void)ctx;
 
     uint8_t status = inb(KEYBOARD_STATUS_PORT);
     if (!(status & 0x01)) {
         // 没有数据，直接返回（安全措施）
-        outb(0x20, 0x20);  // 发送EOI
+        irq_eoi(1);  // 发送EOI
         return;
     }
 
     uint8_t scancode = keyboard_read_scancode();
 
+    // 只缓存扫描码，回显和命令处理放到下半部
     if(scancode < 128) {
+        if(ring_head - ring_tail < SCANCODE_RING_SIZE) {
+            scancode_ring[ring_head % SCANCODE_RING_SIZE] = scancode;
+            ring_head++;
+            tasklet_schedule(&keyboard_tasklet);
+        }
+        else {
+            ring_dropped++;
+        }
+    }
+
+    irq_eoi(1);
+}
+
+/* 开中断执行：把缓存的扫描码转换成字符并处理 */
+static void keyboard_bottom_half(void* data)
+{
+    (void)data;
+
+    while(ring_tail != ring_head) {
+        uint8_t scancode = scancode_ring[ring_tail % SCANCODE_RING_SIZE];
+        ring_tail++;
+
         char c = keyboard_scancode_to_ascii(scancode);
         if(c != 0) {
             keyboard_handle_input(c);
         }
     }
-
-    outb(0x20, 0x20);
 }
 
 char keyboard_read_scancode()
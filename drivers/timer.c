@@ -1,32 +1,252 @@
 #include "timer.h"
 #include "stdio.h"
+#include "cpu.h"
+#include "apic.h"
+#include "softirq.h"
+#include "timer_wheel.h"
 
 volatile uint32_t system_ticks = 0;
 
+/* 动态时钟：空闲时停掉周期 tick，改为单次定时到下一个截止时间，
+ * 唤醒后再按硬件计数器补上睡过的 tick */
+static bool nohz_enabled = true;
+static bool nohz_active = false;
+static bool nohz_lapic = false;             // 用 LAPIC 定时器代替 PIT 做单次定时
+static uint32_t lapic_counts_per_tick = 0;
+static uint32_t oneshot_counts = 0;         // 本次单次定时的计数值（所用定时器的单位）
+static uint32_t counts_remainder = 0;       // 不足一个 tick 的部分，以 PIT 计数为单位
+
+static struct tick_stats stats;
+
+static void pit_set_periodic(void)
+{
+    outb(PIT_COMMAND_PORT, PIT_CH0_RATE);
+    outb(PIT_CHANNEL0_PORT, (uint8_t)(PIT_TICK_COUNTS & 0xFF));
+    outb(PIT_CHANNEL0_PORT, (uint8_t)((PIT_TICK_COUNTS >> 8) & 0xFF));
+}
+
+static void pit_set_oneshot(uint32_t counts)
+{
+    outb(PIT_COMMAND_PORT, PIT_CH0_ONESHOT);
+    outb(PIT_CHANNEL0_PORT, (uint8_t)(counts & 0xFF));
+    outb(PIT_CHANNEL0_PORT, (uint8_t)((counts >> 8) & 0xFF));
+}
+
+/* 回读通道 0：返回当前计数，status 中带 OUT 引脚状态 */
+static uint32_t pit_read_count(uint8_t* status)
+{
+    outb(PIT_COMMAND_PORT, PIT_READBACK_CH0);
+    *status = inb(PIT_CHANNEL0_PORT);
+    uint32_t low = inb(PIT_CHANNEL0_PORT);
+    uint32_t high = inb(PIT_CHANNEL0_PORT);
+    return (high << 8) | low;
+}
+
+/* 通道 2 单次计数，只能轮询，不产生中断；用于校准其他定时器 */
+void pit_ch2_start(uint16_t counts)
+{
+    uint8_t gate = inb(PIT_GATE_PORT);
+    outb(PIT_GATE_PORT, gate & ~0x03);          // 关门控和扬声器
+
+    outb(PIT_COMMAND_PORT, PIT_CH2_ONESHOT);
+    outb(PIT_CHANNEL2_PORT, (uint8_t)(counts & 0xFF));
+    outb(PIT_CHANNEL2_PORT, (uint8_t)((counts >> 8) & 0xFF));
+
+    outb(PIT_GATE_PORT, (gate & ~0x02) | 0x01); // 打开门控开始计数
+}
+
+bool pit_ch2_done(void)
+{
+    return (inb(PIT_GATE_PORT) & 0x20) != 0;
+}
+
+/* 用 PIT 通道 2 量出一个 tick 内 LAPIC 定时器的计数 */
+static uint32_t calibrate_lapic_timer(void)
+{
+    lapic_timer_start(0xFFFFFFFF);
+    pit_ch2_start(PIT_TICK_COUNTS);
+    while(!pit_ch2_done()) asm volatile("pause");
+    uint32_t elapsed = 0xFFFFFFFF - lapic_timer_current();
+    lapic_timer_start(0);
+
+    return elapsed;
+}
+
 void init_timer(void)
 {
-    uint32_t divisor = 1193180 / TIMER_FREQUENCY;
+    pit_set_periodic();
 
-    outb(PIT_COMMAND_PORT, 0x36);
+    if(apic_enabled()) {
+        lapic_counts_per_tick = calibrate_lapic_timer();
+        // 保证最长睡眠的计数不溢出
+        nohz_lapic = lapic_counts_per_tick > 0 &&
+                     lapic_counts_per_tick <= 0xFFFFFFFF / NOHZ_MAX_TICKS;
+        if(nohz_lapic) {
+            register_interrupt_handler(LAPIC_TIMER_VECTOR, timer_interrupt_handler, NULL);
+        }
+    }
 
-    outb(PIT_CHANNEL0_PORT, (uint8_t)(divisor & 0xFF));
-    outb(PIT_CHANNEL0_PORT, (uint8_t)((divisor >> 8) & 0xFF));
+    irq_unmask(0);
 
     printf("PIT TImer initialized at %d Hz\n", TIMER_FREQUENCY);
+    if(nohz_lapic) {
+        printf("Tickless idle via LAPIC timer (%d counts per tick)\n", lapic_counts_per_tick);
+    }
+    else {
+        printf("Tickless idle via PIT one-shot (max %d ticks)\n", 0xFFFF / PIT_TICK_COUNTS);
+    }
 }
 
-void timer_interrupt_handler(void)
+/* 单次定时开始后经过的时间，以 PIT 计数为单位 */
+static uint32_t nohz_elapsed(bool* expired)
 {
-    system_ticks++;
+    if(nohz_lapic) {
+        uint32_t current = lapic_timer_current();
+        *expired = (0 == current);
+        uint32_t counts = oneshot_counts - current;
+        return (uint32_t)div_u64((uint64_t)counts * PIT_TICK_COUNTS, lapic_counts_per_tick);
+    }
+
+    uint8_t status;
+    uint32_t current = pit_read_count(&status);
+    *expired = (status & PIT_STATUS_OUT) != 0;
+    return *expired ? oneshot_counts : oneshot_counts - current;
+}
 
-    if(system_ticks % TIMER_FREQUENCY == 0) {
-        // printf("System uptiem: %d seconds\n", system_ticks/TIMER_FREQUENCY);
+/* 关中断调用：把睡过的时间折算进 system_ticks，恢复周期 tick */
+static void nohz_stop(uint32_t elapsed)
+{
+    uint32_t total = elapsed + counts_remainder;
+    uint32_t ticks = total / PIT_TICK_COUNTS;
+
+    system_ticks += ticks;
+    counts_remainder = total % PIT_TICK_COUNTS;
+    stats.ticks_slept += ticks;
+
+    pit_set_periodic();
+    if(nohz_lapic) {
+        lapic_timer_start(0);
+        irq_unmask(0);
     }
 
-    outb(0x20, 0x20);
+    nohz_active = false;
 }
 
+/* 下一个需要 tick 的时间：时间轮上最近的工作，最多睡 NOHZ_MAX_TICKS */
+static uint32_t ticks_until_next_event(void)
+{
+    return timer_next_event(NOHZ_MAX_TICKS);
+}
+
+/* 关中断调用：条件满足时把周期 tick 换成单次定时 */
+static void tick_nohz_idle_enter(void)
+{
+    if(!nohz_enabled || nohz_active || softirq_pending()) return;
+
+    uint32_t ticks = ticks_until_next_event();
+    if(!nohz_lapic && ticks > 0xFFFF / PIT_TICK_COUNTS) ticks = 0xFFFF / PIT_TICK_COUNTS;
+    if(ticks <= 1) return;
+
+    // 周期模式 2 下计数线性递减，当前周期已过去的部分记入余数
+    uint8_t status;
+    counts_remainder += PIT_TICK_COUNTS - pit_read_count(&status);
+
+    if(nohz_lapic) {
+        irq_mask(0);
+        oneshot_counts = ticks * lapic_counts_per_tick;
+        lapic_timer_start(oneshot_counts);
+    }
+    else {
+        oneshot_counts = ticks * PIT_TICK_COUNTS;
+        pit_set_oneshot(oneshot_counts);
+    }
+
+    nohz_active = true;
+    stats.idle_sleeps++;
+}
+
+/* 被其他中断提前唤醒时补算 tick；已到期的由时钟中断自己处理 */
+static void tick_nohz_idle_exit(void)
+{
+    uint32_t flags = irq_save();
+
+    if(nohz_active) {
+        bool expired;
+        uint32_t elapsed = nohz_elapsed(&expired);
+        if(!expired) {
+            stats.early_wakes++;
+            nohz_stop(elapsed);
+        }
+    }
+
+    irq_restore(flags);
+}
+
+/* 空闲循环的一次睡眠：检查与 hlt 之间不能漏掉唤醒，sti 的下一条指令才开中断 */
+void cpu_idle(void)
+{
+    local_irq_disable();
+    tick_nohz_idle_enter();
+    TRACE_IRQS_ON();
+    asm volatile("sti; hlt");
+
+    stats.idle_wakeups++;
+    tick_nohz_idle_exit();
+}
+
+void tick_nohz_set(bool enabled)
+{
+    nohz_enabled = enabled;
+}
+
+void timer_interrupt_handler(struct interrupt_frame* frame, void* ctx)
+{
+    (void)frame;
+    (void)ctx;
+    stats.timer_irqs++;
+
+    // 进入单次模式前已挂起的周期 tick 也会走到这里，要看硬件是否真的到期
+    bool expired = false;
+    uint32_t elapsed = 0;
+    if(nohz_active) elapsed = nohz_elapsed(&expired);
+
+    if(expired) {
+        nohz_stop(elapsed);
+    }
+    else {
+        system_ticks++;
+    }
+
+    timer_wheel_tick();
+    irq_eoi(0);
+}
+
+/* 单次模式期间 system_ticks 没有更新，按硬件计数估算 */
 uint32_t get_ticks(void)
 {
-    return system_ticks;
-}
\ No newline at end of file
+    uint32_t flags = irq_save();
+    uint32_t ticks = system_ticks;
+
+    if(nohz_active) {
+        bool expired;
+        ticks += (nohz_elapsed(&expired) + counts_remainder) / PIT_TICK_COUNTS;
+    }
+
+    irq_restore(flags);
+    return ticks;
+}
+
+void get_tick_stats(struct tick_stats* out)
+{
+    *out = stats;
+}
+
+void tick_stats_print(void)
+{
+    printf("\n=== Tick Statistics ===\n");
+    printf("Mode: %s, %s\n", nohz_enabled ? "tickless idle" : "periodic",
+           nohz_lapic ? "LAPIC one-shot" : "PIT one-shot");
+    printf("Timer interrupts: %d, idle wakeups: %d\n", stats.timer_irqs, stats.idle_wakeups);
+    printf("One-shot sleeps: %d (%d woken early), %d ticks skipped\n",
+           stats.idle_sleeps, stats.early_wakes, stats.ticks_slept);
+}
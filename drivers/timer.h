@@ -2,13 +2,47 @@
 #define TIMER_H
 
 #include "types.h"
+#include "interrupt.h"
 
 #define PIT_CHANNEL0_PORT 0x40
+#define PIT_CHANNEL2_PORT 0x42
 #define PIT_COMMAND_PORT 0x43
+#define PIT_GATE_PORT 0x61
 #define TIMER_FREQUENCY 100
 
+#define PIT_BASE_FREQUENCY  1193180
+#define PIT_TICK_COUNTS     (PIT_BASE_FREQUENCY / TIMER_FREQUENCY)
+
+/* PIT 控制字 */
+#define PIT_CH0_RATE        0x34    // 通道 0，低/高字节，模式 2 周期
+#define PIT_CH0_ONESHOT     0x30    // 通道 0，低/高字节，模式 0 单次
+#define PIT_CH2_ONESHOT     0xB0    // 通道 2，低/高字节，模式 0 单次
+#define PIT_READBACK_CH0    0xC2    // 回读通道 0 的状态和计数
+#define PIT_STATUS_OUT      0x80
+
+/* 空闲时最多连续睡眠的 tick 数，PIT 单次模式受 16 位计数限制只能更短 */
+#define NOHZ_MAX_TICKS      TIMER_FREQUENCY
+
+/* 动态时钟统计 */
+struct tick_stats
+{
+    uint32_t timer_irqs;        // 时钟中断总数（周期与单次）
+    uint32_t idle_sleeps;       // 以单次模式进入的空闲睡眠
+    uint32_t early_wakes;       // 被其他中断提前唤醒的睡眠
+    uint32_t ticks_slept;       // 单次模式下跳过的 tick 总数
+    uint32_t idle_wakeups;      // 空闲循环中 hlt 返回的次数
+};
+
 void init_timer(void);
 uint32_t get_ticks(void);
-void timer_interrupt_handler(void);
+void timer_interrupt_handler(struct interrupt_frame* frame, void* ctx);
+
+void tick_nohz_set(bool enabled);
+void cpu_idle(void);
+void get_tick_stats(struct tick_stats* stats);
+void tick_stats_print(void);
+
+void pit_ch2_start(uint16_t counts);
+bool pit_ch2_done(void);
 
-#endif
\ No newline at end of file
+#endif
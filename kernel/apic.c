@@ -0,0 +1,467 @@
+#include "apic.h"
+#include "interrupt.h"
+#include "paging.h"
+#include "memory.h"
+#include "stdio.h"
+#include "cpu.h"
+
+/* ACPI 表结构（只用到 RSDT 和 MADT） */
+struct acpi_rsdp {
+    char signature[8];
+    uint8_t checksum;
+    char oem_id[6];
+    uint8_t revision;
+    uint32_t rsdt;
+} __attribute__((packed));
+
+struct acpi_header {
+    char signature[4];
+    uint32_t length;
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__((packed));
+
+struct acpi_madt {
+    struct acpi_header header;
+    uint32_t lapic_addr;
+    uint32_t flags;
+} __attribute__((packed));
+
+#define MADT_LAPIC          0
+#define MADT_IOAPIC         1
+#define MADT_ISO            2
+
+struct madt_ioapic {
+    uint8_t type, length;
+    uint8_t id, reserved;
+    uint32_t addr;
+    uint32_t gsi_base;
+} __attribute__((packed));
+
+struct madt_iso {
+    uint8_t type, length;
+    uint8_t bus, source;
+    uint32_t gsi;
+    uint16_t flags;
+} __attribute__((packed));
+
+/* Intel MP 规范表结构，ACPI 不存在时使用 */
+struct mp_floating {
+    char signature[4];
+    uint32_t config;
+    uint8_t length;
+    uint8_t revision;
+    uint8_t checksum;
+    uint8_t features[5];
+} __attribute__((packed));
+
+struct mp_config {
+    char signature[4];
+    uint16_t length;
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[8];
+    char product_id[12];
+    uint32_t oem_table;
+    uint16_t oem_size;
+    uint16_t entry_count;
+    uint32_t lapic_addr;
+    uint16_t ext_length;
+    uint8_t ext_checksum;
+    uint8_t reserved;
+} __attribute__((packed));
+
+#define MP_PROCESSOR        0
+#define MP_BUS              1
+#define MP_IOAPIC           2
+#define MP_IOINT            3
+#define MP_FEATURE_IMCR     0x80
+
+struct mp_bus {
+    uint8_t type, id;
+    char name[6];
+} __attribute__((packed));
+
+struct mp_ioapic {
+    uint8_t type, id, version, flags;
+    uint32_t addr;
+} __attribute__((packed));
+
+struct mp_ioint {
+    uint8_t type, irq_type;
+    uint16_t flags;
+    uint8_t bus, bus_irq;
+    uint8_t ioapic_id, intin;
+} __attribute__((packed));
+
+struct ioapic {
+    uint32_t id;
+    uint32_t phys;
+    uint32_t gsi_base;
+    uint32_t entries;
+};
+
+/* ISA IRQ 到全局中断号 (GSI) 的路由，默认一一对应 */
+struct isa_route {
+    uint32_t gsi;
+    uint16_t flags;
+};
+
+volatile uint32_t* lapic_base = NULL;
+
+static struct ioapic ioapics[IOAPIC_MAX];
+static uint32_t ioapic_count = 0;
+static struct isa_route isa_routes[ISA_IRQS];
+static uint32_t lapic_phys = 0;
+static uint32_t cpu_count = 0;
+static bool has_imcr = false;
+static const char* table_source = "none";
+static uint32_t spurious_count = 0;
+
+static bool checksum_ok(const void* data, uint32_t length)
+{
+    const uint8_t* bytes = data;
+    uint8_t sum = 0;
+    for(uint32_t i = 0; i < length; i++) sum += bytes[i];
+    return sum == 0;
+}
+
+/* 在 [start, end) 中按 16 字节对齐查找签名 */
+static const void* scan_signature(uint32_t start, uint32_t end, const char* sig, uint32_t sig_len, uint32_t length)
+{
+    for(uint32_t addr = start; addr + length <= end; addr += 16) {
+        if(0 == memcmp((const void*)addr, sig, sig_len) && checksum_ok((const void*)addr, length)) {
+            return (const void*)addr;
+        }
+    }
+    return NULL;
+}
+
+/* BIOS 数据区 0x40E 保存 EBDA 段地址，两种表都先找 EBDA 的前 1KB，再找 BIOS ROM */
+static const void* find_bios_table(const char* sig, uint32_t sig_len, uint32_t length, uint32_t rom_start)
+{
+    uint32_t ebda = (uint32_t)(*(volatile uint16_t*)0x40E) << 4;
+    const void* found = NULL;
+
+    if(ebda) found = scan_signature(ebda, ebda + 1024, sig, sig_len, length);
+    if(!found) found = scan_signature(rom_start, 0x100000, sig, sig_len, length);
+    return found;
+}
+
+static void add_ioapic(uint32_t id, uint32_t phys, uint32_t gsi_base)
+{
+    if(ioapic_count >= IOAPIC_MAX) return;
+
+    // 分页尚未开启，可以直接读物理地址得到重定向表项数
+    volatile uint32_t* regs = (volatile uint32_t*)phys;
+    regs[IOAPIC_REGSEL / 4] = IOAPIC_REG_VERSION;
+    uint32_t version = regs[IOAPIC_WINDOW / 4];
+
+    struct ioapic* io = &ioapics[ioapic_count++];
+    io->id = id;
+    io->phys = phys;
+    io->gsi_base = gsi_base;
+    io->entries = ((version >> 16) & 0xFF) + 1;
+}
+
+static bool parse_madt(void)
+{
+    const struct acpi_rsdp* rsdp = find_bios_table("RSD PTR ", 8, sizeof(struct acpi_rsdp), 0xE0000);
+    if(!rsdp) return false;
+
+    const struct acpi_header* rsdt = (const struct acpi_header*)rsdp->rsdt;
+    if(memcmp(rsdt->signature, "RSDT", 4) || !checksum_ok(rsdt, rsdt->length)) return false;
+
+    const uint32_t* tables = (const uint32_t*)(rsdt + 1);
+    uint32_t table_count = (rsdt->length - sizeof(struct acpi_header)) / 4;
+
+    const struct acpi_madt* madt = NULL;
+    for(uint32_t i = 0; i < table_count && !madt; i++) {
+        const struct acpi_header* h = (const struct acpi_header*)tables[i];
+        if(0 == memcmp(h->signature, "APIC", 4) && checksum_ok(h, h->length)) {
+            madt = (const struct acpi_madt*)h;
+        }
+    }
+    if(!madt) return false;
+
+    lapic_phys = madt->lapic_addr;
+
+    const uint8_t* entry = (const uint8_t*)(madt + 1);
+    const uint8_t* end = (const uint8_t*)madt + madt->header.length;
+    while(entry + 2 <= end && entry[1] >= 2)
+    {
+        if(MADT_LAPIC == entry[0]) {
+            // 标志位 0：处理器可用
+            if(entry[4] & 0x1) cpu_count++;
+        }
+        else if(MADT_IOAPIC == entry[0]) {
+            const struct madt_ioapic* io = (const struct madt_ioapic*)entry;
+            add_ioapic(io->id, io->addr, io->gsi_base);
+        }
+        else if(MADT_ISO == entry[0]) {
+            const struct madt_iso* iso = (const struct madt_iso*)entry;
+            if(0 == iso->bus && iso->source < ISA_IRQS) {
+                isa_routes[iso->source].gsi = iso->gsi;
+                isa_routes[iso->source].flags = iso->flags;
+            }
+        }
+        entry += entry[1];
+    }
+
+    table_source = "ACPI";
+    return ioapic_count > 0;
+}
+
+static bool parse_mp_table(void)
+{
+    const struct mp_floating* mpf = find_bios_table("_MP_", 4, sizeof(struct mp_floating), 0xF0000);
+    if(!mpf) return false;
+
+    has_imcr = (mpf->features[1] & MP_FEATURE_IMCR) != 0;
+    table_source = "MP";
+
+    // 默认配置：没有配置表，固定地址的单个 I/O APIC，ISA 中断一一对应
+    if(mpf->features[0] != 0 || 0 == mpf->config) {
+        cpu_count = 2;
+        add_ioapic(0, 0xFEC00000, 0);
+        return ioapic_count > 0;
+    }
+
+    const struct mp_config* cfg = (const struct mp_config*)mpf->config;
+    if(memcmp(cfg->signature, "PCMP", 4) || !checksum_ok(cfg, cfg->length)) return false;
+
+    lapic_phys = cfg->lapic_addr;
+
+    // 第一遍：处理器、总线和 I/O APIC；MP 表没有 GSI，按出现顺序累加
+    uint32_t isa_buses = 0;
+    uint32_t gsi = 0;
+    const uint8_t* entry = (const uint8_t*)(cfg + 1);
+    for(uint32_t i = 0; i < cfg->entry_count; i++)
+    {
+        if(MP_PROCESSOR == entry[0]) {
+            if(entry[3] & 0x1) cpu_count++;
+            entry += 20;
+            continue;
+        }
+
+        if(MP_BUS == entry[0]) {
+            const struct mp_bus* bus = (const struct mp_bus*)entry;
+            if(bus->id < 32 && 0 == memcmp(bus->name, "ISA", 3)) isa_buses |= 1U << bus->id;
+        }
+        else if(MP_IOAPIC == entry[0]) {
+            const struct mp_ioapic* io = (const struct mp_ioapic*)entry;
+            if(io->flags & 0x1) {
+                add_ioapic(io->id, io->addr, gsi);
+                gsi += ioapics[ioapic_count - 1].entries;
+            }
+        }
+        entry += 8;
+    }
+
+    // 第二遍：ISA 总线上的向量中断分配
+    entry = (const uint8_t*)(cfg + 1);
+    for(uint32_t i = 0; i < cfg->entry_count; i++)
+    {
+        if(MP_PROCESSOR == entry[0]) {
+            entry += 20;
+            continue;
+        }
+
+        const struct mp_ioint* irq = (const struct mp_ioint*)entry;
+        if(MP_IOINT == irq->type && 0 == irq->irq_type && irq->bus < 32 &&
+           (isa_buses & (1U << irq->bus)) && irq->bus_irq < ISA_IRQS)
+        {
+            for(uint32_t j = 0; j < ioapic_count; j++) {
+                if(ioapics[j].id != irq->ioapic_id) continue;
+                isa_routes[irq->bus_irq].gsi = ioapics[j].gsi_base + irq->intin;
+                isa_routes[irq->bus_irq].flags = irq->flags;
+            }
+        }
+        entry += 8;
+    }
+
+    return ioapic_count > 0;
+}
+
+static void reset_tables(void)
+{
+    ioapic_count = 0;
+    cpu_count = 0;
+    for(uint32_t i = 0; i < ISA_IRQS; i++) {
+        isa_routes[i].gsi = i;
+        isa_routes[i].flags = 0;
+    }
+}
+
+/* 在开启分页前调用：表位于物理内存中，直接按物理地址读取 */
+void apic_detect(void)
+{
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    if(!(edx & CPUID_FEAT_EDX_APIC)) {
+        printf("No local APIC, using 8259 PIC\n");
+        return;
+    }
+
+    reset_tables();
+    if(!parse_madt()) {
+        reset_tables();
+        if(!parse_mp_table()) {
+            reset_tables();
+            printf("No ACPI MADT or MP table, using 8259 PIC\n");
+            return;
+        }
+    }
+
+    // MSR 中的基址才是当前生效的
+    lapic_phys = (uint32_t)rdmsr(MSR_APIC_BASE) & APIC_BASE_MASK;
+
+    printf("APIC detected via %s: %d CPU(s), LAPIC at 0x%x, %d I/O APIC(s)\n",
+           table_source, cpu_count, lapic_phys, ioapic_count);
+}
+
+static uint32_t ioapic_read(const struct ioapic* io, uint32_t reg)
+{
+    volatile uint32_t* regs = (volatile uint32_t*)io->phys;
+    regs[IOAPIC_REGSEL / 4] = reg;
+    return regs[IOAPIC_WINDOW / 4];
+}
+
+static void ioapic_write(const struct ioapic* io, uint32_t reg, uint32_t value)
+{
+    volatile uint32_t* regs = (volatile uint32_t*)io->phys;
+    regs[IOAPIC_REGSEL / 4] = reg;
+    regs[IOAPIC_WINDOW / 4] = value;
+}
+
+static struct ioapic* ioapic_for_gsi(uint32_t gsi)
+{
+    for(uint32_t i = 0; i < ioapic_count; i++) {
+        if(gsi >= ioapics[i].gsi_base && gsi < ioapics[i].gsi_base + ioapics[i].entries) {
+            return &ioapics[i];
+        }
+    }
+    return NULL;
+}
+
+/* LAPIC 伪中断不需要 EOI */
+static void lapic_spurious_handler(struct interrupt_frame* frame, void* ctx)
+{
+    (void)frame;
+    (void)ctx;
+    spurious_count++;
+}
+
+/* 在分页开启后、注册设备中断前调用：映射寄存器页，屏蔽 8259，
+ * 启用 LAPIC 并把所有 I/O APIC 输入先屏蔽 */
+void apic_init(void)
+{
+    if(0 == ioapic_count) return;
+
+    uint32_t mmio = PAGE_PRESENT | PAGE_WRITE | PAGE_PCD | PAGE_PWT;
+    if(!map_page(lapic_phys, lapic_phys, mmio)) {
+        printf("APIC: cannot map LAPIC, using 8259 PIC\n");
+        return;
+    }
+    for(uint32_t i = 0; i < ioapic_count; i++) {
+        if(!map_page(ioapics[i].phys, ioapics[i].phys, mmio)) {
+            printf("APIC: cannot map I/O APIC, using 8259 PIC\n");
+            return;
+        }
+    }
+
+    // IMCR 把 8259 从处理器的 INTR 引脚断开，改走 APIC
+    if(has_imcr) {
+        outb(0x22, 0x70);
+        outb(0x23, 0x01);
+    }
+
+    outb(0x21, 0xFF);
+    outb(0xA1, 0xFF);
+
+    wrmsr(MSR_APIC_BASE, rdmsr(MSR_APIC_BASE) | APIC_BASE_ENABLE);
+
+    volatile uint32_t* lapic = (volatile uint32_t*)lapic_phys;
+    lapic[LAPIC_TPR / 4] = 0;
+    lapic[LAPIC_LVT_LINT0 / 4] = LAPIC_LVT_MASKED;
+    register_interrupt_handler(LAPIC_SPURIOUS_VECTOR, lapic_spurious_handler, NULL);
+    lapic[LAPIC_SVR / 4] = LAPIC_SVR_ENABLE | LAPIC_SPURIOUS_VECTOR;
+
+    for(uint32_t i = 0; i < ioapic_count; i++) {
+        for(uint32_t pin = 0; pin < ioapics[i].entries; pin++) {
+            ioapic_write(&ioapics[i], IOAPIC_REG_REDTBL(pin), IOAPIC_MASKED);
+        }
+    }
+
+    lapic_base = lapic;
+    printf("APIC enabled: LAPIC id %d, version 0x%x\n",
+           lapic[LAPIC_ID / 4] >> 24, lapic[LAPIC_VERSION / 4] & 0xFF);
+}
+
+bool apic_enabled(void)
+{
+    return lapic_base != NULL;
+}
+
+/* 把 ISA IRQ 路由到 IRQ_BASE + irq，投递给当前 CPU */
+void ioapic_set_irq(uint8_t irq, bool masked)
+{
+    if(!lapic_base || irq >= ISA_IRQS) return;
+
+    struct isa_route* route = &isa_routes[irq];
+    struct ioapic* io = ioapic_for_gsi(route->gsi);
+    if(!io) return;
+
+    uint32_t low = IRQ(irq);
+    if((route->flags & INTI_POLARITY_MASK) == INTI_POLARITY_LOW) low |= IOAPIC_ACTIVE_LOW;
+    if((route->flags & INTI_TRIGGER_MASK) == INTI_TRIGGER_LEVEL) low |= IOAPIC_LEVEL;
+    if(masked) low |= IOAPIC_MASKED;
+
+    uint32_t pin = route->gsi - io->gsi_base;
+    uint32_t dest = lapic_base[LAPIC_ID / 4] >> 24;
+
+    uint32_t flags = irq_save();
+    ioapic_write(io, IOAPIC_REG_REDTBL(pin) + 1, dest << 24);
+    ioapic_write(io, IOAPIC_REG_REDTBL(pin), low);
+    irq_restore(flags);
+}
+
+/* 单次模式：计数到 0 时在 LAPIC_TIMER_VECTOR 上产生一次中断，count 为 0 时停止 */
+void lapic_timer_start(uint32_t count)
+{
+    lapic_base[LAPIC_TIMER_DIVIDE / 4] = LAPIC_TIMER_DIV_16;
+    lapic_base[LAPIC_LVT_TIMER / 4] = LAPIC_TIMER_VECTOR;
+    lapic_base[LAPIC_TIMER_INITIAL / 4] = count;
+}
+
+uint32_t lapic_timer_current(void)
+{
+    return lapic_base[LAPIC_TIMER_CURRENT / 4];
+}
+
+void apic_stats(void)
+{
+    printf("\n=== Interrupt Controller ===\n");
+    if(!lapic_base) {
+        printf("8259 PIC (no APIC in use)\n");
+        return;
+    }
+
+    printf("LAPIC at 0x%x (from %s), %d spurious\n", lapic_phys, table_source, spurious_count);
+    for(uint32_t i = 0; i < ioapic_count; i++) {
+        printf("  I/O APIC %d at 0x%x: GSI %d-%d, version 0x%x\n",
+               ioapics[i].id, ioapics[i].phys, ioapics[i].gsi_base,
+               ioapics[i].gsi_base + ioapics[i].entries - 1,
+               ioapic_read(&ioapics[i], IOAPIC_REG_VERSION) & 0xFF);
+    }
+    for(uint32_t irq = 0; irq < ISA_IRQS; irq++) {
+        if(isa_routes[irq].gsi != irq || isa_routes[irq].flags) {
+            printf("  IRQ %d -> GSI %d (flags 0x%x)\n", irq, isa_routes[irq].gsi, isa_routes[irq].flags);
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef APIC_H
+#define APIC_H
+
+#include "types.h"
+
+#define CPUID_FEAT_EDX_APIC     (1U << 9)
+
+#define MSR_APIC_BASE           0x1B
+#define APIC_BASE_ENABLE        (1U << 11)
+#define APIC_BASE_MASK          0xFFFFF000
+
+/* Local APIC 寄存器偏移 */
+#define LAPIC_ID                0x020
+#define LAPIC_VERSION           0x030
+#define LAPIC_TPR               0x080
+#define LAPIC_EOI               0x0B0
+#define LAPIC_SVR               0x0F0
+#define LAPIC_LVT_LINT0         0x350
+#define LAPIC_LVT_LINT1         0x360
+#define LAPIC_LVT_TIMER         0x320
+#define LAPIC_TIMER_INITIAL     0x380
+#define LAPIC_TIMER_CURRENT     0x390
+#define LAPIC_TIMER_DIVIDE      0x3E0
+
+#define LAPIC_SVR_ENABLE        (1U << 8)
+#define LAPIC_LVT_MASKED        (1U << 16)
+#define LAPIC_SPURIOUS_VECTOR   0xFF
+#define LAPIC_TIMER_VECTOR      0xEF
+#define LAPIC_TIMER_DIV_16      0x3
+
+/* I/O APIC 通过索引/数据窗口间接访问 */
+#define IOAPIC_REGSEL           0x00
+#define IOAPIC_WINDOW           0x10
+#define IOAPIC_REG_ID           0x00
+#define IOAPIC_REG_VERSION      0x01
+#define IOAPIC_REG_REDTBL(n)    (0x10 + 2 * (n))
+
+#define IOAPIC_ACTIVE_LOW       (1U << 13)
+#define IOAPIC_LEVEL            (1U << 15)
+#define IOAPIC_MASKED           (1U << 16)
+
+#define IOAPIC_MAX              4
+#define ISA_IRQS                16
+
+/* MADT/MP 中断源覆盖的极性与触发方式字段 */
+#define INTI_POLARITY_MASK      0x3
+#define INTI_POLARITY_LOW       0x3
+#define INTI_TRIGGER_MASK       0xC
+#define INTI_TRIGGER_LEVEL      0xC
+
+/* 启用后指向 Local APIC 寄存器页，否则为 NULL */
+extern volatile uint32_t* lapic_base;
+
+/* 写 EOI 寄存器：一次 MMIO 写，代替 8259 的端口 I/O */
+static inline void lapic_eoi(void)
+{
+    lapic_base[LAPIC_EOI / 4] = 0;
+}
+
+void apic_detect(void);
+void apic_init(void);
+bool apic_enabled(void);
+void ioapic_set_irq(uint8_t irq, bool masked);
+void lapic_timer_start(uint32_t count);
+uint32_t lapic_timer_current(void);
+void apic_stats(void);
+
+#endif
@@ -0,0 +1,135 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include "types.h"
+#include "irqsoff.h"
+
+/* 读取时间戳计数器 */
+static inline uint64_t rdtsc(void) {
+    uint32_t low, high;
+    asm volatile ("rdtsc" : "=a"(low), "=d"(high));
+    return ((uint64_t)high << 32) | low;
+}
+
+/* 查找最低位的 1 (bsf)，调用者保证 value != 0 */
+static inline uint32_t bit_scan_forward(uint32_t value) {
+    uint32_t index;
+    asm ("bsf %1, %0" : "=r"(index) : "rm"(value));
+    return index;
+}
+
+/* 查找最高位的 1 (bsr)，调用者保证 value != 0 */
+static inline uint32_t bit_scan_reverse(uint32_t value) {
+    uint32_t index;
+    asm ("bsr %1, %0" : "=r"(index) : "rm"(value));
+    return index;
+}
+
+/* 64 位除以 32 位（内核不链接 libgcc，不能直接使用 64 位除法） */
+static inline uint64_t div_u64(uint64_t dividend, uint32_t divisor) {
+    uint32_t high = (uint32_t)(dividend >> 32);
+    uint32_t low = (uint32_t)dividend;
+    uint32_t rem = high % divisor;
+
+    asm ("divl %2" : "+a"(low), "+d"(rem) : "rm"(divisor));
+    return ((uint64_t)(high / divisor) << 32) | low;
+}
+
+/* CPUID */
+static inline void cpuid(uint32_t leaf, uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx) {
+    asm volatile ("cpuid" : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx) : "a"(leaf), "c"(0));
+}
+
+/* 控制寄存器读写 */
+static inline uint32_t read_cr0(void) {
+    uint32_t value;
+    asm volatile ("mov %%cr0, %0" : "=r"(value));
+    return value;
+}
+
+static inline void write_cr0(uint32_t value) {
+    asm volatile ("mov %0, %%cr0" : : "r"(value) : "memory");
+}
+
+static inline uint32_t read_cr2(void) {
+    uint32_t value;
+    asm volatile ("mov %%cr2, %0" : "=r"(value));
+    return value;
+}
+
+static inline uint32_t read_cr3(void) {
+    uint32_t value;
+    asm volatile ("mov %%cr3, %0" : "=r"(value));
+    return value;
+}
+
+static inline void write_cr3(uint32_t value) {
+    asm volatile ("mov %0, %%cr3" : : "r"(value) : "memory");
+}
+
+static inline uint32_t read_cr4(void) {
+    uint32_t value;
+    asm volatile ("mov %%cr4, %0" : "=r"(value));
+    return value;
+}
+
+static inline void write_cr4(uint32_t value) {
+    asm volatile ("mov %0, %%cr4" : : "r"(value) : "memory");
+}
+
+#define EFLAGS_IF   (1U << 9)
+
+/* 关中断并返回原来的 EFLAGS，配合 irq_restore 使用；
+ * 宿主机基准程序运行在用户态，不能执行 cli，只保留编译器屏障 */
+#ifndef HOST_BUILD
+static inline uint32_t irq_save(void) {
+    uint32_t flags;
+    asm volatile ("pushf; pop %0; cli" : "=r"(flags) : : "memory");
+    if(flags & EFLAGS_IF) TRACE_IRQS_OFF();
+    return flags;
+}
+
+static inline void irq_restore(uint32_t flags) {
+    if(flags & EFLAGS_IF) TRACE_IRQS_ON();
+    asm volatile ("push %0; popf" : : "r"(flags) : "memory", "cc");
+}
+#else
+static inline uint32_t irq_save(void) {
+    asm volatile ("" : : : "memory");
+    return 0;
+}
+
+static inline void irq_restore(uint32_t flags) {
+    (void)flags;
+    asm volatile ("" : : : "memory");
+}
+#endif
+
+/* 直接开关中断，经过这里的才会被关中断追踪记录 */
+static inline void local_irq_disable(void) {
+    asm volatile ("cli" : : : "memory");
+    TRACE_IRQS_OFF();
+}
+
+static inline void local_irq_enable(void) {
+    TRACE_IRQS_ON();
+    asm volatile ("sti" : : : "memory");
+}
+
+/* 读写 MSR */
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t low, high;
+    asm volatile ("rdmsr" : "=a"(low), "=d"(high) : "c"(msr));
+    return ((uint64_t)high << 32) | low;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    asm volatile ("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+/* 使单个线性地址的 TLB 项失效 */
+static inline void invlpg(uint32_t addr) {
+    asm volatile ("invlpg (%0)" : : "r"(addr) : "memory");
+}
+
+#endif
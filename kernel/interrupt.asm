@@ -1,15 +1,16 @@
 section .text
 
-; 外部C函数
-extern divide_by_zero_handler
-extern general_protection_fault_handler
-extern default_exception_handler
-extern timer_interrupt_handler
-extern keyboard_interrupt_handler
+; C 侧的处理函数表，每项 8 字节：处理函数, 上下文
+extern handler_table
+extern irq_exit
+extern irq_account
+%ifdef IRQSOFF_TRACE
+extern trace_irq_entry
+%endif
 
 ; 全局符号
 global idt_load
-global isr0, isr13, isr32, irs33
+global isr_stub_table
 
 ; 加载IDT
 idt_load:
@@ -17,28 +18,21 @@ idt_load:
     lidt [eax]          ; 加载IDT
     ret
 
-%macro ISR_NOERRCODE 1
-global isr%1
-isr%1:
+; 为全部 256 个向量生成入口，统一压入 (错误码, 中断号) 后跳到 isr_common
+; CPU 自己压入错误码的异常：8, 10-14, 17, 21, 29, 30
+%assign i 0
+%rep 256
+isr%[i]:
     cli
-    push byte 0         ; 压入伪错误码
-    push byte %1        ; 压入中断号
+%if i == 8 || (i >= 10 && i <= 14) || i == 17 || i == 21 || i == 29 || i == 30
+    push dword i        ; 压入中断号 (CPU已压入错误码)
+%else
+    push dword 0        ; 压入伪错误码
+    push dword i        ; 压入中断号
+%endif
     jmp isr_common
-%endmacro
-
-%macro ISR_ERRCODE 1
-global isr%1
-isr%1:
-    cli
-    push byte %1        ; 压入中断号 (CPU已压入错误码)
-    jmp isr_common
-%endmacro
-
-; 定义具体的中断处理程序
-ISR_NOERRCODE 0    ; 除零异常
-ISR_ERRCODE 13     ; 通用保护故障
-ISR_NOERRCODE 32    ; 定时器中断（IRQ0）
-ISR_NOERRCODE 33
+%assign i i+1
+%endrep
 
 ; 通用中断处理程序
 isr_common:
@@ -58,45 +52,38 @@ isr_common:
 
     ; 根据新的栈布局获取中断号
     ; 栈布局: gs(4)+fs(4)+es(4)+ds(4)+pusha(32)=48字节
-    mov eax, [esp+48]   ; 获取中断号
-
-    ; 根据中断号调用对应的C处理函数
-    cmp eax, 0
-    je .call_divide_zero
-    cmp eax, 13
-    je .call_general_protection
-    cmp eax, 32
-    je .call_timer
-    cmp eax, 33
-    je .call_keyboard
-    jmp .call_default
-
-.call_divide_zero:
-    push esp            ; 传递栈帧指针给C函数
-    call divide_by_zero_handler
-    add esp, 4
-    jmp .done
-
-.call_general_protection:
-    push esp            ; 传递栈帧指针给C函数
-    call general_protection_fault_handler
+    mov ebx, esp        ; 栈帧指针
+    rdtsc               ; 入口时间戳，放在被调用者保存的 edi:esi 中
+    mov esi, eax
+    mov edi, edx
+%ifdef IRQSOFF_TRACE
+    ; 关中断窗口从入口时间戳开始：trace_irq_entry(frame, 入口时间戳)
+    push edi
+    push esi
+    push ebx
+    call trace_irq_entry
+    add esp, 12
+%endif
+    mov eax, [ebx+48]   ; 获取中断号
+
+    ; 按中断号直接索引处理函数表：handler(frame, ctx)
+    push dword [handler_table + eax*8 + 4]
+    push ebx
+    call dword [handler_table + eax*8]
+    add esp, 8
+
+    ; 统计：irq_account(frame, 入口时间戳)
+    push edi
+    push esi
+    push ebx
+    call irq_account
+    add esp, 12
+
+    ; 硬件中断已应答，开中断执行排队的下半部
+    push ebx
+    call irq_exit
     add esp, 4
-    jmp .done
-
-.call_timer:
-    call timer_interrupt_handler
-    jmp .done
 
-.call_keyboard:
-    call keyboard_interrupt_handler
-    jmp .done
-
-.call_default:
-    push esp
-    call default_exception_handler
-    add esp, 4
-
-.done:
     ; 恢复寄存器
     pop gs
     pop fs
@@ -107,4 +94,14 @@ isr_common:
     add esp, 8          ; 跳过int_no和err_code
 
     sti
-    iret
\ No newline at end of file
+    iret
+
+section .data
+
+; idt_init 用这张表填写 IDT
+isr_stub_table:
+%assign i 0
+%rep 256
+    dd isr%[i]
+%assign i i+1
+%endrep
@@ -1,9 +1,10 @@
 #include "interrupt.h"
 #include "stdio.h"
+#include "cpu.h"
 #include "timer.h"
 #include "keyboard.h"
-
-#define IDT_ENTRIES 256
+#include "apic.h"
+#include "ktime.h"
 
 /* IDT条目 */
 struct idt_entry {
@@ -16,6 +17,14 @@ struct idt_entry {
 
 struct idt_entry idt[IDT_ENTRIES];
 
+/* 按中断号索引的处理函数表，isr_common 直接查表调用 */
+struct interrupt_handler handler_table[IDT_ENTRIES];
+
+static uint32_t spurious_irqs = 0;
+
+/* 只在关中断的公共入口中更新，不需要加锁 */
+static struct interrupt_stats vector_stats[IDT_ENTRIES];
+
 /* IDT指针 */
 struct idt_ptr {
     uint16_t limit;
@@ -54,20 +63,38 @@ static void idt_set_gate(uint8_t num, uint32_t base, uint16_t sel, uint8_t flags
     idt[num].flags = flags;
 }
 
+/* 未注册向量的默认处理：异常停机，IRQ 当作伪中断发送 EOI，其他向量只报告 */
+static void unhandled_interrupt(struct interrupt_frame* frame, void* ctx) {
+    (void)ctx;
+
+    if(frame->int_no < EXCEPTION_COUNT) {
+        default_exception_handler(frame);
+    }
+    else if(frame->int_no < IRQ_BASE + IRQ_COUNT) {
+        spurious_irqs++;
+        irq_eoi(frame->int_no - IRQ_BASE);
+    }
+    else {
+        printf("WARNING: Unhandled interrupt %d at 0x%x\n", frame->int_no, frame->eip);
+    }
+}
+
 /* 初始化IDT */
 void idt_init(void) {
     struct idt_ptr idtp;
     idtp.limit = (sizeof(struct idt_entry) * IDT_ENTRIES) - 1;
     idtp.base = (uint32_t)&idt;
     
-    // 初始化所有IDT条目为0
+    // 所有向量都指向汇编入口，先交给默认处理
     for(int i = 0; i < IDT_ENTRIES; i++) {
-        idt_set_gate(i, 0, 0, 0);
+        idt_set_gate(i, isr_stub_table[i], 0x08, 0x8E);
+        handler_table[i].fn = unhandled_interrupt;
+        handler_table[i].ctx = NULL;
     }
 
-    /* 设置中断处理程序 */
-    idt_set_gate(0, (uint32_t)isr0, 0x08, 0x8E);   // 除零异常
-    idt_set_gate(13, (uint32_t)isr13, 0x08, 0x8E); // 通用保护故障
+    /* 设置异常处理程序，缺页由 paging_init 注册 */
+    register_interrupt_handler(0, divide_by_zero_handler, NULL);
+    register_interrupt_handler(13, general_protection_fault_handler, NULL);
     
     /* 加载IDT */
     idt_load((uint32_t)&idtp); 
@@ -75,6 +102,92 @@ void idt_init(void) {
     printf("IDT initialized with exception handlers\n");
 }
 
+/* 为 vector 注册处理函数；已被占用时返回 0 */
+int register_interrupt_handler(uint8_t vector, interrupt_handler_t fn, void* ctx) {
+    if(!fn) return 0;
+
+    if(handler_table[vector].fn != unhandled_interrupt) {
+        printf("WARNING: Interrupt %d already has a handler\n", vector);
+        return 0;
+    }
+
+    // 处理函数和上下文要一起生效
+    uint32_t flags = irq_save();
+    handler_table[vector].fn = fn;
+    handler_table[vector].ctx = ctx;
+    irq_restore(flags);
+
+    return 1;
+}
+
+void unregister_interrupt_handler(uint8_t vector) {
+    uint32_t flags = irq_save();
+    handler_table[vector].fn = unhandled_interrupt;
+    handler_table[vector].ctx = NULL;
+    irq_restore(flags);
+}
+
+/* isr_common 在处理函数返回后调用：记录从入口到处理结束（含 EOI）的周期数 */
+void irq_account(struct interrupt_frame* frame, uint64_t start)
+{
+    struct interrupt_stats* s = &vector_stats[frame->int_no & 0xFF];
+    uint64_t elapsed = rdtsc() - start;
+    uint32_t cycles = (elapsed >> 32) ? 0xFFFFFFFF : (uint32_t)elapsed;
+
+    uint32_t bucket = 0;
+    if(cycles >> (IRQ_HIST_SHIFT + 1)) {
+        bucket = bit_scan_reverse(cycles) - IRQ_HIST_SHIFT;
+        if(bucket >= IRQ_HIST_BUCKETS) bucket = IRQ_HIST_BUCKETS - 1;
+    }
+
+    s->count++;
+    s->total_cycles += cycles;
+    if(cycles > s->max_cycles) s->max_cycles = cycles;
+    s->hist[bucket]++;
+}
+
+const struct interrupt_stats* get_interrupt_stats(uint8_t vector)
+{
+    return &vector_stats[vector];
+}
+
+/* 类似 /proc/interrupts 的报告，只列出发生过的向量 */
+void interrupt_report(void)
+{
+    const char* chip = apic_enabled() ? "IO-APIC" : "XT-PIC";
+
+    printf("\n=== Interrupts ===\n");
+    printf(" VEC      COUNT   AVG CYC   MAX CYC    MAX NS  SOURCE\n");
+
+    for(uint32_t vec = 0; vec < IDT_ENTRIES; vec++)
+    {
+        const struct interrupt_stats* s = &vector_stats[vec];
+        if(0 == s->count) continue;
+
+        uint32_t avg = (uint32_t)div_u64(s->total_cycles, s->count);
+        printf(" %3d: %10d %9d %9d %9d  ", vec, s->count, avg, s->max_cycles,
+               (uint32_t)ktime_cycles_to_ns(s->max_cycles));
+
+        if(vec < 20) printf("%s\n", exception_messages[vec]);
+        else if(vec < EXCEPTION_COUNT) printf("Reserved exception\n");
+        else if(vec < IRQ_BASE + IRQ_COUNT) printf("%s IRQ%d\n", chip, vec - IRQ_BASE);
+        else if(vec == LAPIC_SPURIOUS_VECTOR) printf("LAPIC spurious\n");
+        else if(vec == LAPIC_TIMER_VECTOR) printf("LAPIC timer\n");
+        else printf("Software\n");
+
+        printf("      hist:");
+        for(uint32_t b = 0; b < IRQ_HIST_BUCKETS - 1; b++) {
+            if(s->hist[b]) printf(" <2^%d:%d", b + IRQ_HIST_SHIFT + 1, s->hist[b]);
+        }
+        if(s->hist[IRQ_HIST_BUCKETS - 1]) {
+            printf(" >=2^%d:%d", IRQ_HIST_BUCKETS + IRQ_HIST_SHIFT - 1, s->hist[IRQ_HIST_BUCKETS - 1]);
+        }
+        printf("\n");
+    }
+
+    printf(" SPU: %10d  unhandled IRQs\n", spurious_irqs);
+}
+
 void init_pic(void)
 {
     outb(0x20, 0x11);
@@ -89,19 +202,55 @@ void init_pic(void)
     outb(0x21, 0x01);
     outb(0xA1, 0x01);
 
-    outb(0x21, 0xFC);
+    // 只留级联线 IRQ2，设备中断由驱动通过 irq_unmask 打开
+    outb(0x21, 0xFB);
     outb(0xA1, 0xFF);
 }
 
+/* 中断结束：APIC 启用后是一次 MMIO 写，否则向 8259 发送 EOI */
+void irq_eoi(uint8_t irq)
+{
+    if(lapic_base) {
+        lapic_eoi();
+        return;
+    }
+
+    if(irq >= 8) outb(0xA0, 0x20);
+    outb(0x20, 0x20);
+}
+
+static void pic_set_mask(uint8_t irq, bool masked)
+{
+    uint16_t port = irq < 8 ? 0x21 : 0xA1;
+    uint8_t bit = 1 << (irq & 7);
+
+    uint32_t flags = irq_save();
+    uint8_t mask = inb(port);
+    outb(port, masked ? (mask | bit) : (mask & ~bit));
+    irq_restore(flags);
+}
+
+void irq_mask(uint8_t irq)
+{
+    if(apic_enabled()) ioapic_set_irq(irq, true);
+    else pic_set_mask(irq, true);
+}
+
+void irq_unmask(uint8_t irq)
+{
+    if(apic_enabled()) ioapic_set_irq(irq, false);
+    else pic_set_mask(irq, false);
+}
+
 void install_timer_interrupt(void)
 {
-    idt_set_gate(32, (uint32_t)isr32, 0x08, 0x8E);
+    register_interrupt_handler(IRQ(0), timer_interrupt_handler, NULL);
     printf("Timer interrupt installed at vector 0x20(IRQ0)\n");
 }
 
 void install_keyboard_interrupt(void)
 {
-    idt_set_gate(33, (uint32_t)isr33, 0x08, 0x8E);
+    register_interrupt_handler(IRQ(1), keyboard_interrupt_handler, NULL);
     printf("Keyboard interrupt installed at vector 0x21 (IRQ1)\n");
 }
 
@@ -121,12 +270,13 @@ void default_exception_handler(struct interrupt_frame* frame) {
     printf("Registers - EAX: 0x%x, EBX: 0x%x, ECX: 0x%x\n", 
            frame->eax, frame->ebx, frame->ecx);
 
-    asm volatile("cli");
+    local_irq_disable();
     while(1) asm volatile("hlt");    
 }
 
 /* 除零异常处理程序 */
-void divide_by_zero_handler(struct interrupt_frame* frame) {
+void divide_by_zero_handler(struct interrupt_frame* frame, void* ctx) {
+    (void)ctx;
     printf("\n=== DIVIDE BY ZERO EXCEPTION ===\n");
     printf("Faulting Instruction: 0x%x\n", frame->eip);
     printf("Registers at fault:\n");
@@ -134,12 +284,13 @@ void divide_by_zero_handler(struct interrupt_frame* frame) {
            frame->eax, frame->ebx, frame->ecx, frame->edx);
     printf("System Halted\n");
     
-    asm volatile("cli");
+    local_irq_disable();
     while(1) asm volatile("hlt");
 }
 
 /* 通用保护故障处理程序 */
-void general_protection_fault_handler(struct interrupt_frame* frame) {
+void general_protection_fault_handler(struct interrupt_frame* frame, void* ctx) {
+    (void)ctx;
     printf("\n=== GENERAL PROTECTION FAULT ===\n");
     printf("Faulting Instruction: 0x%x\n", frame->eip);
     printf("Error Code: 0x%x\n", frame->err_code);
@@ -164,6 +315,6 @@ void general_protection_fault_handler(struct interrupt_frame* frame) {
     
     printf("System Halted\n");
     
-    asm volatile("cli");
+    local_irq_disable();
     while(1) asm volatile("hlt");
 }
\ No newline at end of file
@@ -11,22 +11,61 @@ struct interrupt_frame {
     uint32_t eip, cs, eflags, user_esp, ss;     // CPU自动保存
 };
 
+#define IDT_ENTRIES     256
+#define EXCEPTION_COUNT 32
+
+/* 8259 PIC 重映射后的 IRQ 向量 */
+#define IRQ_BASE        0x20
+#define IRQ_COUNT       16
+#define IRQ(n)          (IRQ_BASE + (n))
+
+/* 中断处理函数，ctx 为注册时传入的上下文 */
+typedef void (*interrupt_handler_t)(struct interrupt_frame* frame, void* ctx);
+
+/* 处理函数表项，汇编入口按 中断号 * 8 直接索引，布局不能改 */
+struct interrupt_handler {
+    interrupt_handler_t fn;
+    void* ctx;
+};
+
+extern struct interrupt_handler handler_table[IDT_ENTRIES];
+
+/* 每个向量的统计槽，独占缓存行；耗时按 2 的幂分桶：
+ * 第 0 桶 < 2^(IRQ_HIST_SHIFT+1) 周期，第 b 桶 [2^(b+SHIFT), 2^(b+SHIFT+1))，最后一桶不设上限 */
+#define IRQ_HIST_BUCKETS    12
+#define IRQ_HIST_SHIFT      6
+#define CACHE_LINE_SIZE     64
+
+struct interrupt_stats {
+    uint32_t count;
+    uint32_t max_cycles;
+    uint64_t total_cycles;
+    uint32_t hist[IRQ_HIST_BUCKETS];
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
 /* 函数声明 */
 void idt_init(void);
 void idt_load(uint32_t idt_ptr);
 void init_pic(void);
+void irq_eoi(uint8_t irq);
+void irq_mask(uint8_t irq);
+void irq_unmask(uint8_t irq);
 void install_timer_interrupt(void);
 void install_keyboard_interrupt(void);
 
-/* 汇编函数声明 */
-extern void isr0(void);
-extern void isr13(void);
-extern void isr32(void);
-extern void isr33(void);
+int register_interrupt_handler(uint8_t vector, interrupt_handler_t fn, void* ctx);
+void unregister_interrupt_handler(uint8_t vector);
+
+void irq_account(struct interrupt_frame* frame, uint64_t start);
+const struct interrupt_stats* get_interrupt_stats(uint8_t vector);
+void interrupt_report(void);
+
+/* 汇编生成的 256 个入口地址 */
+extern uint32_t isr_stub_table[IDT_ENTRIES];
 
 /* 异常处理函数 */
-void divide_by_zero_handler(struct interrupt_frame* frame);
-void general_protection_fault_handler(struct interrupt_frame* frame);
+void divide_by_zero_handler(struct interrupt_frame* frame, void* ctx);
+void general_protection_fault_handler(struct interrupt_frame* frame, void* ctx);
 void default_exception_handler(struct interrupt_frame* frame);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,129 @@
+#include "irqsoff.h"
+#include "ktime.h"
+#include "stdio.h"
+#include "cpu.h"
+
+#ifdef IRQSOFF_TRACE
+
+/* 只在关中断时读写，不需要加锁 */
+static bool off_active = false;
+static uint64_t off_start = 0;
+static uint32_t off_eip = 0;
+static uint32_t off_vector = IRQSOFF_NO_VECTOR;
+
+static struct irqsoff_window top[IRQSOFF_TOP_N];
+static uint32_t top_count = 0;
+static uint32_t windows = 0;
+
+/* 按 cycles 降序维护排行，同一对起止位置只占一项 */
+static void record_window(uint64_t cycles, uint32_t end_eip)
+{
+    windows++;
+
+    uint32_t i = 0;
+    for(; i < top_count; i++) {
+        if(top[i].start_eip == off_eip && top[i].end_eip == end_eip && top[i].vector == off_vector) break;
+    }
+
+    if(i < top_count) {
+        top[i].hits++;
+        if(cycles <= top[i].cycles) return;
+        top[i].cycles = cycles;
+    }
+    else {
+        if(top_count < IRQSOFF_TOP_N) i = top_count++;
+        else if(cycles > top[IRQSOFF_TOP_N - 1].cycles) i = IRQSOFF_TOP_N - 1;
+        else return;
+
+        top[i].cycles = cycles;
+        top[i].start_eip = off_eip;
+        top[i].end_eip = end_eip;
+        top[i].vector = off_vector;
+        top[i].hits = 1;
+    }
+
+    // 变长的一项向前冒泡
+    for(; i > 0 && top[i].cycles > top[i - 1].cycles; i--) {
+        struct irqsoff_window tmp = top[i];
+        top[i] = top[i - 1];
+        top[i - 1] = tmp;
+    }
+}
+
+static void window_begin(uint64_t start, uint32_t eip, uint32_t vector)
+{
+    off_active = true;
+    off_start = start;
+    off_eip = eip;
+    off_vector = vector;
+}
+
+static void window_end(uint32_t eip)
+{
+    if(!off_active) return;
+
+    uint64_t cycles = rdtsc() - off_start;
+    off_active = false;
+    record_window(cycles, eip);
+}
+
+/* 由 irq_save/local_irq_disable 在刚关中断后调用，返回地址就是关中断的位置 */
+__attribute__((noinline)) void trace_irqs_off(void)
+{
+    if(!off_active) window_begin(rdtsc(), (uint32_t)__builtin_return_address(0), IRQSOFF_NO_VECTOR);
+}
+
+/* 由 irq_restore/local_irq_enable 在开中断前调用 */
+__attribute__((noinline)) void trace_irqs_on(void)
+{
+    window_end((uint32_t)__builtin_return_address(0));
+}
+
+/* isr_common 在调用处理函数前调用：被打断的代码原本开着中断时，窗口从入口时间戳算起 */
+void trace_irq_entry(struct interrupt_frame* frame, uint64_t start)
+{
+    if(frame->eflags & EFLAGS_IF) window_begin(start, frame->eip, frame->int_no);
+}
+
+void trace_irq_exit(struct interrupt_frame* frame)
+{
+    if(frame->eflags & EFLAGS_IF) window_end(frame->eip);
+}
+
+void irqsoff_reset(void)
+{
+    uint32_t flags = irq_save();
+    top_count = 0;
+    windows = 0;
+    irq_restore(flags);
+}
+
+uint32_t irqsoff_top(struct irqsoff_window* out, uint32_t max)
+{
+    uint32_t flags = irq_save();
+    uint32_t count = top_count < max ? top_count : max;
+    for(uint32_t i = 0; i < count; i++) out[i] = top[i];
+    irq_restore(flags);
+
+    return count;
+}
+
+/* EIP 可以用 nm -n kernel/kernel.elf 对应到函数 */
+void irqsoff_report(void)
+{
+    struct irqsoff_window snapshot[IRQSOFF_TOP_N];
+    uint32_t count = irqsoff_top(snapshot, IRQSOFF_TOP_N);
+
+    printf("\n=== Longest IRQs-off Windows (%d traced) ===\n", windows);
+    for(uint32_t i = 0; i < count; i++) {
+        const struct irqsoff_window* w = &snapshot[i];
+        uint32_t cycles = (w->cycles >> 32) ? 0xFFFFFFFF : (uint32_t)w->cycles;
+
+        printf(" #%d %10d cycles %8d ns  0x%08x -> 0x%08x  x%d", i + 1, cycles,
+               (uint32_t)ktime_cycles_to_ns(w->cycles), w->start_eip, w->end_eip, w->hits);
+        if(w->vector != IRQSOFF_NO_VECTOR) printf("  (vector %d)", w->vector);
+        printf("\n");
+    }
+}
+
+#endif
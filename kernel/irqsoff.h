@@ -0,0 +1,48 @@
+#ifndef IRQSOFF_H
+#define IRQSOFF_H
+
+#include "types.h"
+#include "interrupt.h"
+
+/* 关中断时长追踪：以 make IRQSOFF_TRACE=1 编译时在每次 cli/sti 和中断进出时打时间戳，
+ * 按起止 EIP 归并，保留最长的 IRQSOFF_TOP_N 个关中断窗口。
+ *
+ * 未追踪的位置：
+ *  - 中断门进入时由 CPU 关中断，入口桩里的 cli 是多余的；窗口从 isr_common 的入口时间戳算起，
+ *    之前压栈和保存段寄存器的几十个周期不计入
+ *  - 窗口在 irq_exit 中结束，之后恢复寄存器和 sti; iret 不计入；iret 按被打断代码的 EFLAGS
+ *    恢复 IF，sti 的中断屏蔽期覆盖 iret，不会在中间响应中断
+ *  - 引导阶段（boot.asm）的 cli 早于追踪初始化
+ *  - 停机路径关中断后不再开启，窗口不会结束，也就不会出现在排行中 */
+#define IRQSOFF_TOP_N       8
+#define IRQSOFF_NO_VECTOR   0xFFFFFFFF      // 窗口从 cli 开始，而不是从中断入口
+
+struct irqsoff_window
+{
+    uint64_t cycles;            // 这对起止位置上最长的一次
+    uint32_t start_eip;         // 关中断的位置；从中断入口开始时为被打断的指令
+    uint32_t end_eip;           // 重新开中断的位置；iret 返回时为恢复执行的指令
+    uint32_t vector;            // 从中断入口开始时的向量号
+    uint32_t hits;              // 进入排行后这对位置又出现的次数
+};
+
+#ifdef IRQSOFF_TRACE
+void trace_irqs_off(void);
+void trace_irqs_on(void);
+void trace_irq_entry(struct interrupt_frame* frame, uint64_t start);     // 由 isr_common 直接调用
+void trace_irq_exit(struct interrupt_frame* frame);
+
+void irqsoff_reset(void);
+uint32_t irqsoff_top(struct irqsoff_window* out, uint32_t max);
+void irqsoff_report(void);
+
+#define TRACE_IRQS_OFF()                trace_irqs_off()
+#define TRACE_IRQS_ON()                 trace_irqs_on()
+#define TRACE_IRQ_EXIT(frame)           trace_irq_exit(frame)
+#else
+#define TRACE_IRQS_OFF()                do { } while(0)
+#define TRACE_IRQS_ON()                 do { } while(0)
+#define TRACE_IRQ_EXIT(frame)           do { } while(0)
+#endif
+
+#endif
@@ -1,8 +1,19 @@
 #include "interrupt.h"
 #include "memory.h"
+#include "buddy.h"
+#include "paging.h"
+#include "slab.h"
+#include "shrinker.h"
+#include "softirq.h"
+#include "apic.h"
+#include "timer_wheel.h"
+#include "ktime.h"
+#include "irqsoff.h"
+#include "cpu.h"
 #include "timer.h"
 #include "keyboard.h"
 #include "heap.h"
+#include "heap_trace.h"
 #include "stdio.h"
 #include "logging.h"
 
@@ -42,6 +53,53 @@ void test_memory_allocation(void) {
     printf("\nAfter freeing:\n");
     print_bitmap_stats();
     
+    printf("\nTesting bulk allocation...\n");
+    uint32_t bulk[16];
+    if (allocate_frames_bulk(16, bulk) == 16) {
+        printf("  Bulk allocated 16 frames: 0x%x ... 0x%x\n", bulk[0], bulk[15]);
+        free_frames_bulk(16, bulk);
+    }
+    print_bitmap_stats();
+
+    printf("\nTesting memory zones...\n");
+    uint32_t normal_frame = allocate_frame();
+    uint32_t dma_frame = alloc_frame_zone(ALLOC_DMA);
+    printf("  Normal frame 0x%x %s, DMA frame 0x%x %s\n",
+           normal_frame, (normal_frame >= ZONE_DMA_LIMIT || !get_zone_free_frames(ZONE_NORMAL)) ? "✓" : "✗",
+           dma_frame, (dma_frame && dma_frame < ZONE_DMA_LIMIT) ? "✓" : "✗");
+    if (normal_frame) free_frame(normal_frame);
+    if (dma_frame) free_frame(dma_frame);
+
+    printf("\nTesting zeroed frames...\n");
+    uint32_t dirty = allocate_frame();
+    if (dirty) {
+        memset((void*)dirty, 0xCC, PAGE_SIZE);
+        free_frame(dirty);
+    }
+    refill_zero_pool();
+    uint32_t pooled = allocate_zeroed_frame();
+    bool zeroed = pooled != 0;
+    for (uint32_t i = 0; zeroed && i < PAGE_SIZE / 4; i++) {
+        if (((uint32_t*)pooled)[i]) zeroed = false;
+    }
+    printf("  Pooled zeroed frame 0x%x %s\n", pooled, zeroed ? "✓" : "✗");
+    if (pooled) free_frame(pooled);
+    print_bitmap_stats();
+
+    printf("\n");
+    benchmark_frame_allocator();
+
+    printf("\nTesting buddy allocator...\n");
+    uint32_t block8k = alloc_pages(1);
+    uint32_t block64k = alloc_pages(4);
+    uint32_t block4m = alloc_pages(BUDDY_MAX_ORDER);
+    printf("  8KB@0x%x, 64KB@0x%x, 4MB@0x%x\n", block8k, block64k, block4m);
+    buddy_stats();
+    if (block4m) free_pages(block4m, BUDDY_MAX_ORDER);
+    if (block64k) free_pages(block64k, 4);
+    if (block8k) free_pages(block8k, 1);
+    buddy_stats();
+
     printf("\nTesting kmalloc (temporary implementation)...\n");
     void* ptr1 = kmalloc(1024);  // 申请1KB
     void* ptr2 = kmalloc(2048);  // 申请2KB
@@ -57,6 +115,249 @@ void test_memory_allocation(void) {
     printf("Memory test completed successfully!\n");
 }
 
+static void test_vector_handler(struct interrupt_frame* frame, void* ctx)
+{
+    *(uint32_t*)ctx = frame->int_no;
+}
+
+void test_interrupt_dispatch(void)
+{
+    printf("\n=== Interrupt Dispatch Test ===\n");
+
+    volatile uint32_t seen = 0;
+    const struct interrupt_stats* stats = get_interrupt_stats(0x81);
+    uint32_t before = stats->count;
+    register_interrupt_handler(0x81, test_vector_handler, (void*)&seen);
+    asm volatile("int $0x81");
+    printf("  int 0x81 -> handler saw vector 0x%x %s\n", seen, seen == 0x81 ? "✓" : "✗");
+
+    uint32_t bucketed = 0;
+    for(uint32_t b = 0; b < IRQ_HIST_BUCKETS; b++) bucketed += stats->hist[b];
+    printf("  Vector counted once %s, histogram matches count %s, %d cycles\n",
+           stats->count == before + 1 ? "✓" : "✗", bucketed == stats->count ? "✓" : "✗",
+           stats->max_cycles);
+
+    bool busy = !register_interrupt_handler(0x81, test_vector_handler, NULL);
+    unregister_interrupt_handler(0x81);
+    bool freed = register_interrupt_handler(0x81, test_vector_handler, (void*)&seen);
+    unregister_interrupt_handler(0x81);
+    printf("  Duplicate registration refused %s, re-register after unregister %s\n",
+           busy ? "✓" : "✗", freed ? "✓" : "✗");
+}
+
+static void test_tasklet_fn(void* data)
+{
+    (*(uint32_t*)data)++;
+}
+
+void test_deferred_work(void)
+{
+    printf("\n=== Deferred Work Test ===\n");
+
+    uint32_t runs = 0;
+    struct tasklet t = TASKLET_INIT(test_tasklet_fn, &runs);
+
+    bool first = tasklet_schedule(&t);
+    bool again = tasklet_schedule(&t);
+    printf("  Schedule %s, duplicate collapsed %s, not run yet %s\n",
+           first ? "✓" : "✗", !again ? "✓" : "✗", runs == 0 ? "✓" : "✗");
+
+    run_deferred_work(SOFTIRQ_BUDGET);
+    printf("  Ran exactly once %s, queue drained %s\n",
+           runs == 1 ? "✓" : "✗", !softirq_pending() ? "✓" : "✗");
+
+    // 预算用完的项留在队列里，下一次再执行
+    struct tasklet hi = TASKLET_INIT(test_tasklet_fn, &runs);
+    tasklet_schedule(&t);
+    tasklet_hi_schedule(&hi);
+    uint32_t done = run_deferred_work(1);
+    bool left = softirq_pending();
+    run_deferred_work(SOFTIRQ_BUDGET);
+    printf("  Budget respected %s, remaining work run later %s\n",
+           done == 1 && left ? "✓" : "✗", runs == 3 && !softirq_pending() ? "✓" : "✗");
+
+    softirq_stats();
+}
+
+void test_interrupt_controller(void)
+{
+    printf("\n=== Interrupt Controller Test ===\n");
+    printf("  Controller: %s\n", apic_enabled() ? "LAPIC + I/O APIC" : "8259 PIC");
+
+    // 连续收到多个时钟中断说明路由和 EOI 都正常，循环有上限以免卡死
+    uint32_t start = get_ticks();
+    local_irq_enable();
+    for(uint32_t spin = 0; spin < 200000000 && get_ticks() - start < 3; spin++) {
+        asm volatile("pause");
+    }
+    local_irq_disable();
+
+    uint32_t seen = get_ticks() - start;
+    printf("  Timer ticks delivered: %d %s\n", seen, seen >= 3 ? "✓" : "✗");
+
+    const struct interrupt_stats* timer = get_interrupt_stats(IRQ(0));
+    printf("  Timer vector count covers ticks %s\n", timer->count >= seen ? "✓" : "✗");
+    interrupt_report();
+
+    apic_stats();
+}
+
+/* 一秒内的时钟中断与空闲唤醒次数 */
+static void measure_wakeups(bool idle, uint32_t* irqs, uint32_t* wakeups)
+{
+    struct tick_stats before, after;
+    get_tick_stats(&before);
+
+    uint32_t start = get_ticks();
+    local_irq_enable();
+    while(get_ticks() - start < TIMER_FREQUENCY) {
+        if(idle) cpu_idle();
+        else asm volatile("pause");
+    }
+    local_irq_disable();
+
+    get_tick_stats(&after);
+    *irqs = after.timer_irqs - before.timer_irqs;
+    *wakeups = after.idle_wakeups - before.idle_wakeups;
+}
+
+void test_tickless(void)
+{
+    printf("\n=== Tickless Idle Test ===\n");
+
+    uint32_t busy_irqs, busy_wakeups, idle_irqs, idle_wakeups, periodic_irqs, periodic_wakeups;
+    measure_wakeups(false, &busy_irqs, &busy_wakeups);
+
+    tick_nohz_set(false);
+    measure_wakeups(true, &periodic_irqs, &periodic_wakeups);
+    tick_nohz_set(true);
+
+    measure_wakeups(true, &idle_irqs, &idle_wakeups);
+
+    printf("  Under load:      %d timer irqs/s\n", busy_irqs);
+    printf("  Idle, periodic:  %d timer irqs/s, %d wakeups/s\n", periodic_irqs, periodic_wakeups);
+    printf("  Idle, tickless:  %d timer irqs/s, %d wakeups/s %s\n", idle_irqs, idle_wakeups,
+           idle_irqs < periodic_irqs ? "✓" : "✗");
+
+    tick_stats_print();
+}
+
+static void test_timer_fn(void* arg)
+{
+    *(uint32_t*)arg = get_ticks();
+}
+
+void test_timer_wheel(void)
+{
+    printf("\n=== Timer Wheel Test ===\n");
+
+    static struct timer near, removed, moved, far;
+    uint32_t near_at = 0, removed_at = 0, moved_at = 0, far_at = 0;
+    uint32_t start = get_ticks();
+
+    timer_add(&near, start + 2, test_timer_fn, &near_at);
+    timer_add(&removed, start + 5, test_timer_fn, &removed_at);
+    timer_add(&moved, start + 40, test_timer_fn, &moved_at);
+    timer_add(&far, start + 100000, test_timer_fn, &far_at);
+    timer_del(&removed);
+    timer_mod(&moved, start + 8);
+
+    // 空闲等待，同时检验动态时钟会按最近的定时器醒来
+    local_irq_enable();
+    while(get_ticks() - start < 12) cpu_idle();
+    local_irq_disable();
+
+    printf("  Expired on time %s, deleted timer silent %s, modified timer moved %s\n",
+           near_at >= start + 2 && near_at <= start + 3 ? "✓" : "✗",
+           removed_at == 0 ? "✓" : "✗",
+           moved_at >= start + 8 && moved_at <= start + 9 ? "✓" : "✗");
+    printf("  Far timer still pending %s\n", timer_pending(&far) && far_at == 0 ? "✓" : "✗");
+    timer_del(&far);
+
+    timer_wheel_stats();
+}
+
+void test_ktime(void)
+{
+    printf("\n=== Clocksource Test ===\n");
+
+    // 单调性
+    bool monotonic = true;
+    uint64_t prev = ktime_get_ns();
+    for(int i = 0; i < 10000; i++) {
+        uint64_t now = ktime_get_ns();
+        if(now < prev) monotonic = false;
+        prev = now;
+    }
+    printf("  ktime_get_ns monotonic %s\n", monotonic ? "✓" : "✗");
+
+    // 与 PIT tick 对照走 20 个 tick，误差应在一个 tick 之内
+    local_irq_enable();
+    uint32_t start = get_ticks();
+    while(get_ticks() == start) asm volatile("pause");
+    uint64_t ns_start = ktime_get_ns();
+    start = get_ticks();
+    while(get_ticks() - start < 20) asm volatile("pause");
+    uint64_t elapsed = ktime_get_ns() - ns_start;
+    local_irq_disable();
+
+    uint32_t us = (uint32_t)elapsed / 1000;
+    printf("  20 ticks measured as %d us %s\n", us, us >= 190000 && us <= 210000 ? "✓" : "✗");
+
+    uint64_t c0 = ktime_get_cycles();
+    uint64_t c1 = ktime_get_cycles();
+    printf("  ktime_get_cycles back-to-back: %d cycles (%d ns)\n",
+           (uint32_t)(c1 - c0), (uint32_t)ktime_cycles_to_ns(c1 - c0));
+}
+
+#ifdef IRQSOFF_TRACE
+void test_irqsoff(void)
+{
+    printf("\n=== IRQs-off Tracer Test ===\n");
+    irqsoff_reset();
+
+    // 故意制造一个比正常中断处理长得多的关中断窗口
+    uint32_t flags = irq_save();
+    uint64_t start = rdtsc();
+    while(rdtsc() - start < 2000000) asm volatile("pause");
+    irq_restore(flags);
+
+    struct irqsoff_window top[IRQSOFF_TOP_N];
+    uint32_t count = irqsoff_top(top, IRQSOFF_TOP_N);
+    uint32_t here = (uint32_t)test_irqsoff;
+
+    printf("  Longest window recorded %s, starts and ends in this function %s\n",
+           count && top[0].cycles >= 2000000 ? "✓" : "✗",
+           count && top[0].start_eip > here && top[0].start_eip < here + 0x400 &&
+           top[0].end_eip > top[0].start_eip && top[0].end_eip < here + 0x400 ? "✓" : "✗");
+
+    irqsoff_report();
+}
+#endif
+
+void test_paging(void)
+{
+    printf("\n=== Paging Test ===\n");
+
+    uint32_t frame = allocate_frame();
+    uint32_t virt = 0xF0000000;
+
+    if (frame && map_page(virt, frame, PAGE_PRESENT | PAGE_WRITE)) {
+        *(volatile uint32_t*)virt = 0x12345678;
+        printf("  map_page 0x%x -> 0x%x: read back 0x%x %s\n", virt, frame,
+               *(volatile uint32_t*)frame,
+               get_physical_address(virt) == frame ? "✓" : "✗");
+
+        unmap_page(virt);
+        printf("  unmap_page: 0x%x %s\n", virt,
+               get_physical_address(virt) == 0 ? "✓" : "✗");
+        free_frame(frame);
+    }
+
+    paging_stats();
+    benchmark_paging();
+}
+
 void test_heap_allocator()
 {
     printf("\n=== Heap Allocator Test ===\n");
@@ -124,7 +425,35 @@ void test_heap_allocator()
     }
     
     heap_stats();
-    
+
+    printf("\n  Testing demand-zero paging...\n");
+    uint8_t* lazy = (uint8_t*)kmalloc(64 * 1024);
+    if (lazy) {
+        // 读未触碰的页映射共享零页，写入时才分配私有帧
+        uint8_t before = lazy[32 * 1024];
+        lazy[32 * 1024] = 0x5A;
+        printf("  Untouched byte read as %d, after write %d %s\n", before, lazy[32 * 1024],
+               (before == 0 && lazy[32 * 1024] == 0x5A) ? "✓" : "✗");
+        kfree(lazy);
+    }
+
+    heap_stats();
+
+    printf("\n  Testing heap segments...\n");
+    uint8_t* big = (uint8_t*)kmalloc(2 * 1024 * 1024);  // 超过初始段，新建一个段
+    if (big) {
+        memset(big, 0xA5, 2 * 1024 * 1024);
+        printf("  ✓ 2MB allocation in new segment: 0x%x\n", big);
+        heap_stats();
+
+        kfree(big);   // 使用率低于水位线，尾部空段归还帧分配器
+        printf("  Freed 2MB block, trailing segment released\n");
+    } else {
+        printf("  ✗ 2MB allocation failed\n");
+    }
+
+    heap_stats();
+
     printf("\n4. Testing fragmentation...\n");
     
     // 创建碎片化模式：分配-释放交替
@@ -155,10 +484,143 @@ void test_heap_allocator()
     
     heap_stats();
     heap_dump();
+
+    printf("\n5. Testing krealloc and kcalloc...\n");
+
+    uint8_t* grow = (uint8_t*)kmalloc(100);
+    for (int i = 0; grow && i < 100; i++) grow[i] = (uint8_t)i;
+
+    uint8_t* grown = (uint8_t*)krealloc(grow, 4000);
+    bool kept = grown != NULL;
+    for (int i = 0; kept && i < 100; i++) {
+        if (grown[i] != (uint8_t)i) kept = false;
+    }
+    printf("  krealloc 100B -> 4000B: 0x%x -> 0x%x %s\n", grow, grown, kept ? "✓" : "✗");
+
+    uint8_t* shrunk = (uint8_t*)krealloc(grown, 50);
+    printf("  krealloc 4000B -> 50B in place: %s\n", shrunk == grown ? "✓" : "✗");
+    kfree(shrunk);
+
+    uint32_t* zeroed = (uint32_t*)kcalloc(256, sizeof(uint32_t));
+    bool all_zero = zeroed != NULL;
+    for (int i = 0; all_zero && i < 256; i++) {
+        if (zeroed[i]) all_zero = false;
+    }
+    printf("  kcalloc(256, 4) zeroed: %s\n", all_zero ? "✓" : "✗");
+    kfree(zeroed);
+
+    printf("\n6. Testing aligned allocation...\n");
+
+    void* line = kmalloc_aligned(100, 64);
+    void* page = kmalloc_page(5000);
+    printf("  64B aligned: 0x%x %s\n", line, ((uint32_t)line & 63) == 0 ? "✓" : "✗");
+    printf("  4KB aligned: 0x%x %s\n", page, ((uint32_t)page & 0xFFF) == 0 ? "✓" : "✗");
+    kfree(line);
+    kfree(page);
+    heap_stats();
+
+    printf("\n7. Testing compact block format...\n");
+
+    // 旧格式块头 16 字节：32 字节负载占 48 字节
+    void* small = kmalloc(32);
+    uint32_t block_bytes = ksize(small) + sizeof(struct heap_block_header);
+    printf("  kmalloc(32) uses a %d-byte block, %d bytes saved vs 48 %s\n",
+           block_bytes, 48 - block_bytes, block_bytes < 48 ? "✓" : "✗");
+    kfree(small);
+
+    benchmark_kmalloc();
+    benchmark_krealloc();
+    heap_stats();
+    heap_report();
     
     printf("\n=== Heap Test Completed ===\n");
 }
 
+struct test_object {
+    uint32_t magic;
+    uint32_t data[10];
+};
+
+static void test_object_ctor(void* obj)
+{
+    ((struct test_object*)obj)->magic = 0xCAFEBABE;
+}
+
+void test_slab_allocator(void)
+{
+    printf("\n=== Slab Allocator Test ===\n");
+
+    struct kmem_cache* cache = kmem_cache_create("test_object", sizeof(struct test_object),
+                                                 0, test_object_ctor);
+    if (!cache) {
+        printf("  ✗ kmem_cache_create failed\n");
+        return;
+    }
+
+    static struct test_object* objs[200];
+    bool constructed = true;
+    for (int i = 0; i < 200; i++) {
+        objs[i] = kmem_cache_alloc(cache);
+        if (!objs[i] || objs[i]->magic != 0xCAFEBABE) constructed = false;
+    }
+    printf("  Allocated 200 objects: %s\n", constructed ? "✓ constructed" : "✗ bad object");
+    kmem_cache_stats();
+
+    for (int i = 0; i < 200; i++) {
+        kmem_cache_free(cache, objs[i]);
+    }
+    printf("  Freed all objects\n");
+    heap_stats();
+    kmem_cache_stats();
+
+    // 空 slab 和大空闲块里驻留的页都可以被 shrinker 交还
+    uint32_t reclaimed = shrink_memory(64, 0);
+    printf("  Shrinkers reclaimed %d pages %s\n", reclaimed, reclaimed ? "✓" : "✗");
+    shrinker_stats();
+
+    kmem_cache_destroy(cache);
+}
+
+#ifdef HEAP_TRACE
+void test_heap_trace(void)
+{
+    printf("\n=== Heap Trace Test ===\n");
+
+    heap_trace_reset();
+
+    // 随机分配与释放，产生一段轨迹
+    static void* ptrs[256];
+    uint32_t seed = 2024;
+    for (int op = 0; op < 3000; op++) {
+        seed = seed * 1103515245 + 12345;
+        uint32_t slot = (seed >> 8) % 256;
+        if (ptrs[slot]) {
+            kfree(ptrs[slot]);
+            ptrs[slot] = NULL;
+        } else {
+            ptrs[slot] = kmalloc(8 + (seed >> 16) % 2000);
+        }
+    }
+    for (int i = 0; i < 256; i++) {
+        kfree(ptrs[i]);
+        ptrs[i] = NULL;
+    }
+
+    uint32_t bytes = heap_trace_dump(NULL, 0);
+    void* trace = kmalloc(bytes);
+    if (!trace || !heap_trace_dump(trace, bytes)) {
+        printf("  ✗ Trace dump failed\n");
+        kfree(trace);
+        return;
+    }
+    printf("  Dumped %d bytes of trace\n", bytes);
+
+    struct heap_replay_result result;
+    printf("  Replay: %s\n", heap_trace_replay(trace, bytes, &result) ? "✓" : "✗");
+    kfree(trace);
+}
+#endif
+
 void kernel_main(void) {
     clear_screen();
     printf("MyOS Boot Start...\n");
@@ -167,17 +629,35 @@ void kernel_main(void) {
     // 1. 初始化中断系统
     idt_init();
     init_pic();
+    apic_detect();
     install_timer_interrupt();
     install_keyboard_interrupt();
+    test_interrupt_dispatch();
+    test_deferred_work();
     
     // 2. 初始化内存管理系统
     memory_init();
-    
+    paging_init();
+    apic_init();
+
+    test_paging();
     test_heap_allocator();
+#ifdef HEAP_TRACE
+    test_heap_trace();
+#endif
+    test_slab_allocator();
 
     // 3. 初始化硬件驱动
     init_timer();
+    ktime_init();
     keyboard_init();
+    test_interrupt_controller();
+    test_tickless();
+    test_timer_wheel();
+    test_ktime();
+#ifdef IRQSOFF_TRACE
+    test_irqsoff();
+#endif
     
     // test_stdio_functions();
     test_logging_system();
@@ -188,9 +668,14 @@ void kernel_main(void) {
     printf("os> ");
     
     // 启用中断
-    asm volatile("sti");
+    local_irq_enable();
     
     while(1) {
-        asm volatile("hlt");
+        // 空闲时在后台回收，分配路径上就很少需要同步回收
+        reclaim_background();
+        refill_zero_pool();
+        // 中断返回时没做完的下半部在这里补上
+        run_deferred_work(SOFTIRQ_BUDGET);
+        cpu_idle();
     }
 }
\ No newline at end of file
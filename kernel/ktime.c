@@ -0,0 +1,117 @@
+#include "ktime.h"
+#include "timer.h"
+#include "stdio.h"
+#include "cpu.h"
+
+#define NSEC_PER_TICK   (NSEC_PER_SEC / TIMER_FREQUENCY)
+
+/* 时钟源：不变 TSC 时 ns = (cycles * tsc_mult) >> tsc_shift，否则退回 PIT tick */
+static bool has_tsc = false;
+static bool tsc_invariant = false;
+static bool use_tsc = false;
+static uint32_t tsc_khz = 0;
+static uint32_t tsc_mult = 0;
+static uint32_t tsc_shift = 0;
+
+/* 用 PIT 通道 2 量一次 TSC 在 counts 个 PIT 计数内走过的周期 */
+static uint64_t measure_tsc(uint16_t counts)
+{
+    pit_ch2_start(counts);
+    uint64_t start = rdtsc();
+    while(!pit_ch2_done()) asm volatile("pause");
+    return rdtsc() - start;
+}
+
+static uint32_t calibrate_tsc_khz(void)
+{
+    uint32_t counts = PIT_TICK_COUNTS * TSC_CALIBRATE_TICKS;
+    uint64_t best = 0;
+
+    // SMI 等只会让某一次变长，取最短的
+    for(uint32_t i = 0; i < TSC_CALIBRATE_ROUNDS; i++) {
+        uint64_t cycles = measure_tsc((uint16_t)counts);
+        if(0 == best || cycles < best) best = cycles;
+    }
+
+    // khz = cycles / (counts / PIT_BASE_FREQUENCY) / 1000
+    return (uint32_t)div_u64(div_u64(best * PIT_BASE_FREQUENCY, counts), 1000);
+}
+
+/* 选尽量大的 shift，让 mult 仍放得进 32 位 */
+static void compute_mult_shift(uint32_t khz)
+{
+    for(tsc_shift = 32; tsc_shift > 0; tsc_shift--) {
+        uint64_t mult = div_u64((uint64_t)1000000 << tsc_shift, khz);
+        if(mult <= 0xFFFFFFFF) {
+            tsc_mult = (uint32_t)mult;
+            return;
+        }
+    }
+    tsc_mult = (uint32_t)div_u64(1000000, khz);
+}
+
+void ktime_init(void)
+{
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    has_tsc = (edx & CPUID_FEAT_EDX_TSC) != 0;
+
+    cpuid(CPUID_EXT_MAX, &eax, &ebx, &ecx, &edx);
+    if(eax >= CPUID_EXT_POWER) {
+        cpuid(CPUID_EXT_POWER, &eax, &ebx, &ecx, &edx);
+        tsc_invariant = (edx & CPUID_POWER_EDX_INVARIANT) != 0;
+    }
+
+    if(has_tsc) {
+        tsc_khz = calibrate_tsc_khz();
+        if(tsc_khz) compute_mult_shift(tsc_khz);
+    }
+
+    // 频率会随 P 状态变化或在空闲时停走的 TSC 不能当时钟源，只用来数周期
+    use_tsc = tsc_invariant && tsc_khz != 0;
+
+    if(use_tsc) {
+        printf("Clocksource: invariant TSC at %d.%03d MHz\n", tsc_khz / 1000, tsc_khz % 1000);
+    }
+    else if(tsc_khz) {
+        printf("Clocksource: PIT ticks (TSC %d.%03d MHz is not invariant)\n", tsc_khz / 1000, tsc_khz % 1000);
+    }
+    else {
+        printf("Clocksource: PIT ticks (no TSC)\n");
+    }
+}
+
+/* 64 位周期乘 32 位 mult 的 96 位积右移 shift，拆成两次 32x32 乘法 */
+uint64_t ktime_cycles_to_ns(uint64_t cycles)
+{
+    if(!tsc_mult) return 0;
+
+    uint64_t low = (uint64_t)(uint32_t)cycles * tsc_mult;
+    uint64_t high = (uint64_t)(uint32_t)(cycles >> 32) * tsc_mult;
+
+    return (high << (32 - tsc_shift)) + (low >> tsc_shift);
+}
+
+/* 开机以来的纳秒数；没有可用 TSC 时精度只有一个 tick */
+uint64_t ktime_get_ns(void)
+{
+    if(use_tsc) return ktime_cycles_to_ns(rdtsc());
+    return (uint64_t)get_ticks() * NSEC_PER_TICK;
+}
+
+/* 原始周期计数，用于测量短代码路径；没有 TSC 时返回 tick 数 */
+uint64_t ktime_get_cycles(void)
+{
+    if(has_tsc) return rdtsc();
+    return get_ticks();
+}
+
+bool ktime_tsc_stable(void)
+{
+    return use_tsc;
+}
+
+uint32_t ktime_tsc_khz(void)
+{
+    return tsc_khz;
+}
@@ -0,0 +1,24 @@
+#ifndef KTIME_H
+#define KTIME_H
+
+#include "types.h"
+
+#define CPUID_FEAT_EDX_TSC          (1U << 4)
+#define CPUID_EXT_MAX               0x80000000
+#define CPUID_EXT_POWER             0x80000007
+#define CPUID_POWER_EDX_INVARIANT   (1U << 8)
+
+#define NSEC_PER_SEC        1000000000ULL
+
+/* 校准：PIT 通道 2 计 5 个 tick（约 50ms，不超过 16 位计数），取多次中最短的一次 */
+#define TSC_CALIBRATE_TICKS     5
+#define TSC_CALIBRATE_ROUNDS    3
+
+void ktime_init(void);
+uint64_t ktime_get_ns(void);
+uint64_t ktime_get_cycles(void);
+uint64_t ktime_cycles_to_ns(uint64_t cycles);
+bool ktime_tsc_stable(void);
+uint32_t ktime_tsc_khz(void);
+
+#endif
@@ -0,0 +1,259 @@
+#include "buddy.h"
+#include "memory.h"
+#include "shrinker.h"
+#include "stdio.h"
+
+/* 页状态按物理页号索引：池中的页带 BUDDY_OWNED，空闲块首页另记 BUDDY_FREE | order */
+#define BUDDY_FREE          0x80
+#define BUDDY_OWNED         0x40
+#define BUDDY_ORDER_MASK    0x0F
+
+static struct buddy_block* free_lists[BUDDY_ORDERS];
+static uint32_t free_counts[BUDDY_ORDERS];
+
+static uint8_t* page_state = NULL;
+static uint32_t state_pages = 0;
+static uint32_t pool_pages = 0;
+static uint32_t pool_grows = 0;
+static uint32_t pool_releases = 0;
+
+static inline struct buddy_block* page_to_block(uint32_t index)
+{
+    return (struct buddy_block*)(index * PAGE_SIZE);
+}
+
+static inline uint32_t block_to_page(struct buddy_block* block)
+{
+    return (uint32_t)block / PAGE_SIZE;
+}
+
+static inline bool page_owned(uint32_t index)
+{
+    return index < state_pages && (page_state[index] & BUDDY_OWNED);
+}
+
+static void push_block(uint32_t index, uint32_t order)
+{
+    struct buddy_block* block = page_to_block(index);
+
+    block->prev = NULL;
+    block->next = free_lists[order];
+    if(free_lists[order]) {
+        free_lists[order]->prev = block;
+    }
+    free_lists[order] = block;
+
+    page_state[index] = BUDDY_OWNED | BUDDY_FREE | order;
+    free_counts[order]++;
+}
+
+static void remove_block(uint32_t index, uint32_t order)
+{
+    struct buddy_block* block = page_to_block(index);
+
+    if(block->prev) block->prev->next = block->next;
+    else free_lists[order] = block->next;
+
+    if(block->next) block->next->prev = block->prev;
+
+    page_state[index] = BUDDY_OWNED;
+    free_counts[order]--;
+}
+
+uint32_t pages_to_order(uint32_t pages)
+{
+    uint32_t order = 0;
+    while((1U << order) < pages) {
+        order++;
+    }
+    return order;
+}
+
+void buddy_init(void)
+{
+    printf("Initializing buddy allocator...\n");
+
+    for(uint32_t order = 0; order < BUDDY_ORDERS; order++) {
+        free_lists[order] = NULL;
+        free_counts[order] = 0;
+    }
+
+    // 每个物理页一个状态字节，池本身按需从位图取页
+    state_pages = get_total_memory() / PAGE_SIZE;
+    uint32_t meta_pages = (state_pages + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    page_state = (uint8_t*)allocate_frame_range(meta_pages, PAGE_SIZE);
+    if(!page_state) {
+        printf("BUDDY ERROR: Cannot allocate %d pages of page state\n", meta_pages);
+        state_pages = 0;
+        return;
+    }
+    memset(page_state, 0, state_pages);
+
+    printf("Buddy allocator: %d pages tracked, %d metadata pages\n", state_pages, meta_pages);
+}
+
+/* 从位图取一个 2^order 页的对齐块放入池中 */
+static bool pool_grow(uint32_t order, uint32_t flags)
+{
+    uint32_t pages = 1U << order;
+    uint32_t addr = alloc_frame_range_zone(pages, pages * PAGE_SIZE, flags);
+    if(!addr) return false;
+
+    uint32_t index = addr / PAGE_SIZE;
+    if(index + pages > state_pages) {
+        free_frame_range(addr, pages);
+        return false;
+    }
+
+    memset(&page_state[index], BUDDY_OWNED, pages);
+    push_block(index, order);
+
+    pool_pages += pages;
+    pool_grows++;
+    return true;
+}
+
+/* 把完整空闲的取入块交还位图；先清掉归属，free_frame 才会接受这些帧 */
+static void pool_release(uint32_t index, uint32_t order)
+{
+    uint32_t pages = 1U << order;
+
+    remove_block(index, order);
+    memset(&page_state[index], 0, pages);
+    free_frame_range(index * PAGE_SIZE, pages);
+
+    pool_pages -= pages;
+    pool_releases++;
+}
+
+/* 返回不小于 order 的最低非空阶，没有时返回 BUDDY_ORDERS */
+static uint32_t find_free_order(uint32_t order)
+{
+    uint32_t current = order;
+    while(current < BUDDY_ORDERS && !free_lists[current]) {
+        current++;
+    }
+    return current;
+}
+
+/* 分配 2^order 个物理连续页，返回物理地址；失败返回 0 */
+uint32_t alloc_pages(uint32_t order)
+{
+    if(order > BUDDY_MAX_ORDER || !page_state) {
+        return 0;
+    }
+
+    uint32_t current = find_free_order(order);
+
+    // 池中没有足够大的块时优先取整个最大阶块，不为它触发回收；位图碎片化时只取所需大小，
+    // 这次分配失败前会先让各缓存交还页，交还到池里的页也要重新查找
+    if(current == BUDDY_ORDERS) {
+        if(!pool_grow(BUDDY_MAX_ORDER, ALLOC_NORECLAIM) && order < BUDDY_MAX_ORDER) {
+            pool_grow(order, ALLOC_NORMAL);
+        }
+        current = find_free_order(order);
+    }
+
+    if(current == BUDDY_ORDERS) {
+        printf("BUDDY ERROR: No free block of order %d\n", order);
+        return 0;
+    }
+
+    uint32_t index = block_to_page(free_lists[current]);
+    remove_block(index, current);
+
+    // 逐级拆分，后一半挂回低一阶链表
+    while(current > order) {
+        current--;
+        push_block(index + (1U << current), current);
+    }
+
+    return index * PAGE_SIZE;
+}
+
+/* 块内每页都应是已分配的池页，外层也不能有覆盖它的空闲块 */
+static bool block_allocated(uint32_t index, uint32_t order)
+{
+    for(uint32_t i = index; i < index + (1U << order); i++) {
+        if(page_state[i] != BUDDY_OWNED) return false;
+    }
+
+    for(uint32_t outer = order + 1; outer <= BUDDY_MAX_ORDER; outer++) {
+        uint8_t state = page_state[index & ~((1U << outer) - 1)];
+        if((state & BUDDY_FREE) && (state & BUDDY_ORDER_MASK) >= outer) return false;
+    }
+
+    return true;
+}
+
+void free_pages(uint32_t addr, uint32_t order)
+{
+    uint32_t index = addr / PAGE_SIZE;
+
+    if(order > BUDDY_MAX_ORDER || (addr & (PAGE_SIZE - 1)) || (index & ((1U << order) - 1)) ||
+       index + (1U << order) > state_pages || !page_owned(index) || !page_owned(index + (1U << order) - 1)) {
+        printf("BUDDY ERROR: Invalid free of 0x%x (order %d)\n", addr, order);
+        return;
+    }
+
+    if(!block_allocated(index, order)) {
+        printf("BUDDY WARNING: Double free detected at 0x%x\n", addr);
+        return;
+    }
+
+    // 伙伴空闲且同阶就合并，最多 BUDDY_MAX_ORDER 次
+    uint32_t buddy = index;
+    while(order < BUDDY_MAX_ORDER)
+    {
+        buddy = index ^ (1U << order);
+        if(!page_owned(buddy) || page_state[buddy] != (BUDDY_OWNED | BUDDY_FREE | order)) {
+            break;
+        }
+
+        remove_block(buddy, order);
+        if(buddy < index) index = buddy;
+        order++;
+    }
+
+    bool whole = (BUDDY_MAX_ORDER == order) || !page_owned(index ^ (1U << order));
+    bool others_free = buddy_free_pages() > 0;
+
+    push_block(index, order);
+
+    // 合并到整个取入块后交还位图，但池里没有其他空闲页时留作下次分配
+    if(whole && others_free) {
+        pool_release(index, order);
+    }
+}
+
+/* 地址所在的页是否属于伙伴池（无论空闲与否） */
+bool buddy_owns(uint32_t addr)
+{
+    return page_owned(addr / PAGE_SIZE);
+}
+
+uint32_t buddy_free_blocks(uint32_t order)
+{
+    return order < BUDDY_ORDERS ? free_counts[order] : 0;
+}
+
+uint32_t buddy_free_pages(void)
+{
+    uint32_t pages = 0;
+    for(uint32_t order = 0; order < BUDDY_ORDERS; order++) {
+        pages += free_counts[order] << order;
+    }
+    return pages;
+}
+
+void buddy_stats(void)
+{
+    printf("\n=== Buddy Allocator ===\n");
+    printf("Pool: %d pages (%d grows, %d releases), free: %d pages\n",
+           pool_pages, pool_grows, pool_releases, buddy_free_pages());
+    for(uint32_t order = 0; order < BUDDY_ORDERS; order++) {
+        printf("  order %2d (%4d KB): %d free\n",
+               order, (PAGE_SIZE << order) / 1024, free_counts[order]);
+    }
+}
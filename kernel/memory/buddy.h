@@ -0,0 +1,29 @@
+#ifndef BUDDY_H
+#define BUDDY_H
+
+#include "types.h"
+
+#define BUDDY_MAX_ORDER     10
+#define BUDDY_ORDERS        (BUDDY_MAX_ORDER + 1)
+#define BUDDY_MAX_PAGES     (1 << BUDDY_MAX_ORDER)
+
+/* 伙伴池建在帧位图之上：没有足够大的空闲块时从位图取一个对齐块，
+ * 合并成完整的取入块后交还位图，只保留最后一个空闲块以免反复取还 */
+
+/* 空闲块头，直接存放在空闲页的起始位置 */
+struct buddy_block
+{
+    struct buddy_block* next;
+    struct buddy_block* prev;
+};
+
+void buddy_init(void);
+uint32_t alloc_pages(uint32_t order);
+void free_pages(uint32_t addr, uint32_t order);
+uint32_t pages_to_order(uint32_t pages);
+bool buddy_owns(uint32_t addr);
+uint32_t buddy_free_blocks(uint32_t order);
+uint32_t buddy_free_pages(void);
+void buddy_stats(void);
+
+#endif
@@ -1,221 +1,745 @@
 #include "heap.h"
+#include "heap_trace.h"
 #include "memory.h"
+#include "paging.h"
+#include "shrinker.h"
 #include "stdio.h"
+#include "cpu.h"
 // #include "string.h"
 
-static struct heap_block_header* heap_start = NULL;
-static struct heap_block_header* heap_end = NULL;
 static uint32_t heap_total_size = 0;
 static uint32_t heap_used_size = 0;
 static uint32_t total_allocations = 0;
 static uint32_t total_frees = 0;
 
+static struct heap_segment segments[HEAP_MAX_SEGMENTS];
+static uint32_t segment_count = 0;
+static uint32_t segment_releases = 0;
+
+/* 此地址以上的堆内存从未分配出去过，仍是按需清零的页 */
+static uint32_t heap_fresh_start = HEAP_START;
+
+static uint32_t realloc_in_place = 0;
+static uint32_t realloc_moves = 0;
+static uint32_t realloc_copied = 0;
+static uint32_t calloc_calls = 0;
+static uint32_t calloc_skipped = 0;
+
+static uint32_t aligned_allocs = 0;
+static uint32_t aligned_slack = 0;
+static uint32_t aligned_waste = 0;
+
+static struct heap_instrumentation instr;
+static struct shrinker heap_shrinker;
+
+/* 分离空闲链表：每个大小类一条链表，位图记录哪些类非空 */
+static struct heap_block_header* free_lists[HEAP_CLASS_COUNT];
+static uint32_t free_class_map[HEAP_CLASS_WORDS];
+
+#define HEAP_HEADER_SIZE    sizeof(struct heap_block_header)
+
+static inline uint32_t block_size(struct heap_block_header* block)
+{
+    return block->size & HEAP_SIZE_MASK;
+}
+
+static inline bool block_used(struct heap_block_header* block)
+{
+    return (block->size & HEAP_BLOCK_USED) != 0;
+}
+
+static inline bool prev_used(struct heap_block_header* block)
+{
+    return (block->size & HEAP_PREV_USED) != 0;
+}
+
+static inline void* block_payload(struct heap_block_header* block)
+{
+    return (uint8_t*)block + HEAP_HEADER_SIZE;
+}
+
+static inline struct heap_block_header* payload_block(void* ptr)
+{
+    return (struct heap_block_header*)((uint8_t*)ptr - HEAP_HEADER_SIZE);
+}
+
+/* 相邻块靠地址计算：下一块紧接本块之后，前一块（空闲时）的大小记在本块之前的尾标记里 */
+static inline struct heap_block_header* next_block(struct heap_block_header* block)
+{
+    return (struct heap_block_header*)((uint8_t*)block + block_size(block));
+}
+
+static inline struct heap_block_header* prev_block(struct heap_block_header* block)
+{
+    uint32_t prev_size = *((uint32_t*)block - 1);
+    return (struct heap_block_header*)((uint8_t*)block - prev_size);
+}
+
+static inline void set_footer(struct heap_block_header* block)
+{
+    *(uint32_t*)((uint8_t*)next_block(block) - sizeof(uint32_t)) = block_size(block);
+}
+
+static inline struct heap_free_links* free_links(struct heap_block_header* block)
+{
+    return (struct heap_free_links*)block_payload(block);
+}
+
+/* 请求大小 -> 含块头并对齐后的块大小 */
+static inline uint32_t block_size_for(uint32_t size)
+{
+    uint32_t total_size = ALIGN(size + HEAP_HEADER_SIZE);
+    return total_size < HEAP_MIN_BLOCK_SIZE ? HEAP_MIN_BLOCK_SIZE : total_size;
+}
+
+static inline void mark_touched(struct heap_block_header* block)
+{
+    uint32_t end = (uint32_t)next_block(block);
+    if(end > heap_fresh_start) heap_fresh_start = end;
+}
+
+static inline uint32_t msb(uint32_t value)
+{
+    uint32_t index;
+    asm ("bsr %1, %0" : "=r"(index) : "rm"(value));
+    return index;
+}
+
+/* 块大小 -> 所属大小类（向下取整），用于插入空闲链表 */
+static uint32_t size_to_class(uint32_t size)
+{
+    if(size < HEAP_MIN_CLASS_SIZE) size = HEAP_MIN_CLASS_SIZE;
+
+    uint32_t fl = msb(size);
+    uint32_t sl = (size >> (fl - HEAP_SL_BITS)) & (HEAP_SL_COUNT - 1);
+    return (fl - HEAP_MIN_CLASS_SHIFT) * HEAP_SL_COUNT + sl;
+}
+
+/* 请求大小 -> 第一个其中所有块都足够大的类（向上取整），用于查找 */
+static uint32_t request_to_class(uint32_t size)
+{
+    if(size < HEAP_MIN_CLASS_SIZE) size = HEAP_MIN_CLASS_SIZE;
+
+    uint32_t round = (1U << (msb(size) - HEAP_SL_BITS)) - 1;
+    return size_to_class(size + round);
+}
+
+static void free_list_insert(struct heap_block_header* block)
+{
+    uint32_t index = size_to_class(block_size(block));
+    struct heap_free_links* links = free_links(block);
+
+    links->prev_free = NULL;
+    links->next_free = free_lists[index];
+    if(free_lists[index]) {
+        free_links(free_lists[index])->prev_free = block;
+    }
+    free_lists[index] = block;
+
+    free_class_map[index / 32] |= 1U << (index % 32);
+}
+
+static void free_list_remove(struct heap_block_header* block)
+{
+    uint32_t index = size_to_class(block_size(block));
+    struct heap_free_links* links = free_links(block);
+
+    if(links->prev_free) free_links(links->prev_free)->next_free = links->next_free;
+    else free_lists[index] = links->next_free;
+
+    if(links->next_free) free_links(links->next_free)->prev_free = links->prev_free;
+
+    if(!free_lists[index]) {
+        free_class_map[index / 32] &= ~(1U << (index % 32));
+    }
+}
+
+/* 从 index 开始找第一个非空的大小类，没有返回 HEAP_CLASS_COUNT */
+static uint32_t find_free_class(uint32_t index)
+{
+    if(index >= HEAP_CLASS_COUNT) return HEAP_CLASS_COUNT;
+
+    uint32_t word = index / 32;
+    uint32_t bits = free_class_map[word] & (~0U << (index % 32));
+    uint32_t steps = 1;
+
+    while(!bits && word + 1 < HEAP_CLASS_WORDS) {
+        bits = free_class_map[++word];
+        steps++;
+    }
+
+    // 命中时再算上取出的链表头节点
+    if(bits) steps++;
+
+    instr.searches++;
+    instr.search_steps += steps;
+    if(steps > instr.max_search_steps) instr.max_search_steps = steps;
+
+    return bits ? word * 32 + bit_scan_forward(bits) : HEAP_CLASS_COUNT;
+}
+
+
+/* 在 [start, start + size) 建立新段：开头填充使负载 8 字节对齐，随后一个空闲块，末尾是栅栏块头；
+ * 返回段内的空闲块 */
+static struct heap_block_header* segment_create(uint32_t start, uint32_t size)
+{
+    struct heap_block_header* block = (struct heap_block_header*)(start + HEAP_HEADER_SIZE);
+    struct heap_block_header* fence =
+        (struct heap_block_header*)(start + size - HEAP_HEADER_SIZE);
+
+    // 段首块前面没有可合并的块，栅栏块视为已使用，合并不会越过段边界
+    block->size = (size - HEAP_SEGMENT_OVERHEAD) | HEAP_PREV_USED;
+    set_footer(block);
+    fence->size = HEAP_BLOCK_USED;
+
+    segments[segment_count].start = start;
+    segments[segment_count].size = size;
+    segment_count++;
+
+    heap_total_size += size;
+    heap_used_size += HEAP_SEGMENT_OVERHEAD;
+
+    free_list_insert(block);
+    return block;
+}
 
 void heap_init(void)
 {
     printf("Initializing kernel heap...\n");
 
-    heap_start = (struct heap_block_header*)HEAP_START;
+    // 预留整个堆虚拟区间，首次访问时才分配物理帧
+    if(!reserve_demand_region(HEAP_START, HEAP_MAX_SIZE)) {
+        printf("HEAP ERROR: Cannot reserve heap region at 0x%x\n", HEAP_START);
+        return;
+    }
+
+    memset(free_lists, 0, sizeof(free_lists));
+    memset(free_class_map, 0, sizeof(free_class_map));
+
+    heap_total_size = 0;
+    heap_used_size = 0;
+    segment_count = 0;
+    heap_fresh_start = HEAP_START;
 
-    heap_start->size = HEAP_INIT_SIZE;
-    heap_start->used = 0;
-    heap_start->next = NULL;
-    heap_start->prev = NULL;
+    memset(&instr, 0, sizeof(instr));
+    instr.alloc.min = 0xFFFFFFFF;
+    instr.free.min = 0xFFFFFFFF;
 
-    heap_end = heap_start;
-    heap_total_size = HEAP_INIT_SIZE;
-    heap_used_size = sizeof(struct heap_block_header);
+    segment_create(HEAP_START, HEAP_INIT_SIZE);
+    register_shrinker(&heap_shrinker);
 
     HEAP_DEBUG("Heap initialized at 0x%x", HEAP_START);
     HEAP_DEBUG("Initial heap size: %d KB", HEAP_INIT_SIZE / 1024);
-    HEAP_DEBUG("First block size: %d bytes", heap_start->size);
 }
 
-static void split_block(struct heap_block_header* block, uint32_t size)
+/* 把块拆成 size 和剩余两部分，剩余部分挂入空闲链表；返回是否拆分。
+ * 调用者随后把 block 标记为已使用 */
+static int split_block(struct heap_block_header* block, uint32_t size)
 {
-    uint32_t remaining_size = block->size - size;
+    uint32_t remaining_size = block_size(block) - size;
 
-    if(remaining_size > sizeof(struct heap_block_header) + HEAP_ALIGNMENT) {
+    if(remaining_size >= HEAP_MIN_BLOCK_SIZE) {
         struct heap_block_header* new_block = 
                     (struct heap_block_header*)((uint8_t*)block + size);
 
-        new_block->size = remaining_size;
-        new_block->used = 0;
-        new_block->next = block->next;
-        new_block->prev = block;
-
-        if(block->next) {
-            block->next->prev = new_block;
-        }
+        block->size = size | (block->size & ~HEAP_SIZE_MASK);
+        new_block->size = remaining_size | HEAP_PREV_USED;
+        set_footer(new_block);
+        next_block(new_block)->size &= ~HEAP_PREV_USED;
 
-        block->next = new_block;
-        block->size = size;
-
-        if(heap_end == block) {
-            heap_end = new_block;
-        }
+        free_list_insert(new_block);
 
         HEAP_DEBUG("Split block: 0x%x ->0x%x (%d bytes) and 0x%x (%d bytes)",
-                block, block, block->size, new_block, new_block->size);
+                block, block, size, new_block, remaining_size);
+        return 1;
     }
+
+    return 0;
+}
+
+static inline void mark_used(struct heap_block_header* block)
+{
+    block->size |= HEAP_BLOCK_USED;
+    next_block(block)->size |= HEAP_PREV_USED;
 }
 
-static int heap_expand(uint32_t size)
+/* 新建一段容纳 size 字节的块，返回段内的空闲块，失败返回 NULL。
+ * 页取整后的块可能落在比 request_to_class(size) 低的类里，调用者直接从返回的块分配 */
+static struct heap_block_header* heap_expand(uint32_t size)
 {
-    if(heap_total_size >= HEAP_MAX_SIZE) {
-        printf("HEAP ERROR: Maximum heap size reached!\n");
-        return 0;
+    if(segment_count >= HEAP_MAX_SEGMENTS) {
+        printf("HEAP ERROR: Maximum heap segments reached!\n");
+        return NULL;
     }
 
-    uint32_t pages_needed = (size + PAGE_SIZE - 1) / PAGE_SIZE;
-    uint32_t expand_size = pages_needed * PAGE_SIZE;
+    // 新段至少容纳请求和段开销，并按当前堆大小几何增长，减少扩展次数
+    uint32_t needed = (size + HEAP_SEGMENT_OVERHEAD + PAGE_SIZE - 1) & PAGE_ADDR_MASK;
+    uint32_t expand_size = heap_total_size < HEAP_SEGMENT_MAX ? heap_total_size : HEAP_SEGMENT_MAX;
+    if(expand_size < needed) expand_size = needed;
 
-    if(heap_total_size + expand_size > HEAP_MAX_SIZE) {
-        printf("HEAP ERROR: Expansion would exceed max heap size\n");
-        return 0;
+    if(expand_size > HEAP_MAX_SIZE - heap_total_size) {
+        expand_size = HEAP_MAX_SIZE - heap_total_size;
     }
 
-    uint32_t new_frame = allocate_frame();
-    if(!new_frame) {
-        printf("HEAP ERROR: Out of physical memory during expandsion\n");
-        return 0;
+    if(expand_size < needed) {
+        printf("HEAP ERROR: Expansion would exceed max heap size\n");
+        return NULL;
     }
 
-    struct heap_block_header* new_block = (struct heap_block_header*)new_frame;
-    new_block->size = expand_size;
-    new_block->used = 0;
-    new_block->next = NULL;
-    new_block->prev = heap_end;
+    // 堆在预留的虚拟区间内连续增长，物理帧由缺页处理按需分配
+    uint32_t new_segment = HEAP_START + heap_total_size;
+    struct heap_block_header* block = segment_create(new_segment, expand_size);
+    instr.expansions++;
+
+    HEAP_DEBUG("Heap expanded by %d  bytes at 0x%x", expand_size, new_segment);
+    return block;
+}
+
+/* 使用率低于水位线（force 时不看水位线）时，把堆尾完全空闲的段归还给帧分配器 */
+static void heap_shrink(bool force)
+{
+    while(segment_count > 1)
+    {
+        struct heap_segment* segment = &segments[segment_count - 1];
+        struct heap_block_header* block =
+            (struct heap_block_header*)(segment->start + HEAP_HEADER_SIZE);
+
+        if(block_used(block) || block_size(block) != segment->size - HEAP_SEGMENT_OVERHEAD) {
+            break;
+        }
+
+        // 按释放后的堆大小判断，避免在水位线附近反复扩展和收缩
+        uint32_t remaining = heap_total_size - segment->size;
+        uint32_t used = heap_used_size - HEAP_SEGMENT_OVERHEAD;
+        if(!force && (uint64_t)used * 100 >= (uint64_t)remaining * HEAP_SHRINK_WATERMARK) {
+            break;
+        }
+
+        free_list_remove(block);
 
-    if(heap_end) {
-        heap_end->next = new_block;
+        release_demand_pages(segment->start, segment->size);
+        if(heap_fresh_start > segment->start) heap_fresh_start = segment->start;
+
+        heap_total_size = remaining;
+        heap_used_size = used;
+        segment_count--;
+        segment_releases++;
+
+        HEAP_DEBUG("Released heap segment at 0x%x", segment->start);
     }
+}
+
+/* 从空闲块开头取出 total_size 字节标记为已使用，剩余部分拆回空闲链表 */
+static void* take_block(struct heap_block_header* block, uint32_t total_size)
+{
+    free_list_remove(block);
+    split_block(block, total_size);
+    mark_used(block);
 
-    heap_end = new_block;
-    heap_total_size += expand_size;
+    heap_used_size += block_size(block);
+    total_allocations++;
+    mark_touched(block);
 
-    HEAP_DEBUG("Heap expanded by %d  bytes at 0x%x", expand_size, new_frame);
-    return 1;
+    return block_payload(block);
 }
 
-void* kmalloc(uint32_t size)
+static void* heap_alloc(uint32_t size)
 {
     if(0 == size) return NULL;
 
-    uint32_t total_size = ALIGN(size + sizeof(struct heap_block_header));
+    if(size > HEAP_MAX_SIZE) {
+        printf("HEAP ERROR: Allocation of %d bytes exceeds heap size\n", size);
+        return NULL;
+    }
+
+    uint32_t total_size = block_size_for(size);
     HEAP_DEBUG("kmalloc requesst: %d bytes -> %bytes with header", size, total_size);
     
-    struct heap_block_header* current = heap_start;
-    while (current)
-    {
-        if(!current->used && current->size >= total_size) {
-            HEAP_DEBUG("Found free block at 0x%x, size: %d bytes", current, current->size);
+    // 直接定位到第一个非空且块都足够大的大小类，O(1)
+    struct heap_block_header* current = NULL;
+    uint32_t index = find_free_class(request_to_class(total_size));
+    if(index < HEAP_CLASS_COUNT) {
+        current = free_lists[index];
+        HEAP_DEBUG("Found free block at 0x%x, size: %d bytes", current, block_size(current));
+    }
+    else {
+        HEAP_DEBUG("No suitable block found, expanding heap...");
+        current = heap_expand(total_size);
+    }
 
-            if(current->size >= total_size + sizeof(struct heap_block_header) + HEAP_ALIGNMENT) {
-                split_block(current, total_size);
-            }
+    if(!current) {
+        printf("HEAP ERROR: Out of memory for allocation of %d bytes\n", size);
+        return NULL;
+    }
 
-            current->used = 1;
-            heap_used_size += current->size;
-            total_allocations++;
+    void* ptr = take_block(current, total_size);
+    HEAP_DEBUG("Allocated %d bytes at 0x%x", size, ptr);
+    return ptr;
+}
 
-            void* ptr = (void*)((uint8_t*)current + sizeof(struct heap_block_header));
-            HEAP_DEBUG("Allocated %d bytes at 0x%x", size, ptr);
+/* 与前后相邻的空闲块合并后挂入空闲链表；block 已标记为空闲但尚未入链 */
+static void merge_free_block(struct heap_block_header* block)
+{
+    uint32_t size = block_size(block);
+    struct heap_block_header* next = next_block(block);
 
-            return ptr;
-        }
+    if(!block_used(next)) {
+        HEAP_DEBUG("Merging 0x%x with next block 0x%x", block, next);
 
-        current = current->next;
+        free_list_remove(next);
+        size += block_size(next);
     }
 
-    HEAP_DEBUG("No suitable block found, expanding heap...");
+    if(!prev_used(block)) {
+        struct heap_block_header* prev = prev_block(block);
+        HEAP_DEBUG("Merging 0x%x with previous block 0x%x", prev, block);
 
-    if(heap_expand(total_size)) {
-        return kmalloc(size);
+        free_list_remove(prev);
+        size += block_size(prev);
+        block = prev;
     }
 
-    printf("HEAP ERROR: Out of memory for allocation of %d bytes\n", size);
-    return NULL;    
+    // 空闲块不会相邻，合并后的块前面一定是已使用块
+    block->size = size | HEAP_PREV_USED;
+    set_footer(block);
+    next_block(block)->size &= ~HEAP_PREV_USED;
+
+    free_list_insert(block);
 }
 
-static void merge_free_block(struct heap_block_header* block)
+static void heap_free(void* ptr)
 {
-    if(block->next && !block->next->used) {
-        HEAP_DEBUG("Merging 0x%x with next block 0x%x", block, block->next);
+    struct heap_block_header* header = payload_block(ptr);
 
-        block->size += block->next->size;
-        block->next = block->next->next;
-
-        if(block->next) block->next->prev = block;
-        else heap_end = block;
+    if(!block_used(header) || 0 == block_size(header)) {
+        printf("HEAP WARNING: Double free detected at 0x%x\n", ptr);
+        return;
     }
 
-    if(block->prev && !block->prev->used) {
-        HEAP_DEBUG("Merging 0x%x with previous block 0x%x", block->prev, block);
+    HEAP_DEBUG("Freeing block at 0x%x (header: 0x%x, size: %d bytes)",
+                ptr, header, block_size(header));
+
+    header->size &= ~HEAP_BLOCK_USED;
+    heap_used_size -= block_size(header);
+    total_frees++;
 
-        block->prev->size += block->size;
-        block->prev->next = block->next;
+    merge_free_block(header);
+    heap_shrink(false);
+}
 
-        if(block->next) {
-            block->next->prev = block->prev;
-        }
-        else {
-            heap_end = block->prev;
+/* 空闲块内部不含块头、链表指针和尾标记的整页，交还后下次访问重新按需清零 */
+static bool free_block_pages(struct heap_block_header* block, uint32_t* start, uint32_t* end)
+{
+    *start = ((uint32_t)block + HEAP_HEADER_SIZE + sizeof(struct heap_free_links) + PAGE_SIZE - 1) &
+             ~(PAGE_SIZE - 1);
+    *end = ((uint32_t)next_block(block) - sizeof(uint32_t)) & ~(PAGE_SIZE - 1);
+    return *end > *start;
+}
+
+static uint32_t resident_heap_pages(void)
+{
+    struct page_fault_stats faults;
+    get_page_fault_stats(&faults);
+    return faults.resident_pages;
+}
+
+static uint32_t heap_shrink_count(void* ctx)
+{
+    (void)ctx;
+    uint32_t pages = 0;
+    uint32_t start, end;
+
+    for(uint32_t i = 0; i < HEAP_CLASS_COUNT; i++) {
+        for(struct heap_block_header* block = free_lists[i]; block;
+            block = free_links(block)->next_free) {
+            if(free_block_pages(block, &start, &end)) pages += (end - start) / PAGE_SIZE;
         }
+    }
+
+    // 交还过的页不再驻留，用驻留页数封顶
+    uint32_t resident = resident_heap_pages();
+    return pages < resident ? pages : resident;
+}
+
+/* 堆操作中途可能因缺页进入直接回收，那时空闲链表不一定一致，所以只参与后台回收 */
+static uint32_t heap_shrink_scan(void* ctx, uint32_t pages, uint32_t flags)
+{
+    (void)ctx;
+    if(flags & SHRINK_DIRECT) return 0;
+
+    uint32_t before = resident_heap_pages();
+    uint32_t start, end;
 
-        block = block->prev;
+    heap_shrink(true);
+
+    // 从最大的类开始，大块交还的页最多
+    for(uint32_t i = HEAP_CLASS_COUNT; i > 0; i--) {
+        for(struct heap_block_header* block = free_lists[i - 1]; block;
+            block = free_links(block)->next_free) {
+            if(before - resident_heap_pages() >= pages) return before - resident_heap_pages();
+            if(free_block_pages(block, &start, &end)) release_demand_pages(start, end - start);
+        }
     }
+
+    return before - resident_heap_pages();
+}
+
+static struct shrinker heap_shrinker = {
+    "heap", heap_shrink_count, heap_shrink_scan, NULL, 0, 0, NULL
+};
+
+static void record_latency(struct heap_latency* latency, uint64_t cycles)
+{
+    uint32_t value = cycles > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)cycles;
+
+    latency->calls++;
+    latency->total += value;
+    if(value < latency->min) latency->min = value;
+    if(value > latency->max) latency->max = value;
+    latency->hist[msb(value | 1)]++;
+}
+
+void* kmalloc(uint32_t size)
+{
+    uint64_t start = rdtsc();
+    void* ptr = heap_alloc(size);
+    record_latency(&instr.alloc, rdtsc() - start);
+
+    if(size) instr.size_hist[msb(size)]++;
+    HEAP_TRACE_ALLOC(ptr, size);
+    return ptr;
 }
 
 void kfree(void* ptr)
 {
     if(!ptr) return;
 
-    struct heap_block_header* header = 
-        (struct heap_block_header*)((uint8_t*)ptr - sizeof(struct heap_block_header));
+    HEAP_TRACE_RELEASE(ptr);
 
+    uint64_t start = rdtsc();
+    heap_free(ptr);
+    record_latency(&instr.free, rdtsc() - start);
+}
 
-    if(!header->used) {
-        printf("HEAP WARNING: Double free detected at 0x%x\n", ptr);
-        return;
+/* 已分配块的可用字节数 */
+uint32_t ksize(void* ptr)
+{
+    if(!ptr) return 0;
+    return block_size(payload_block(ptr)) - HEAP_HEADER_SIZE;
+}
+
+/* 按 align 对齐分配；前部的填充拆成空闲块，留给后续分配 */
+static void* heap_alloc_aligned(uint32_t size, uint32_t align)
+{
+    if(align & (align - 1)) {
+        printf("HEAP ERROR: Alignment %d is not a power of two\n", align);
+        return NULL;
     }
 
-    HEAP_DEBUG("Freeing block at 0x%x (header: 0x%x, size: %d bytes)",
-                ptr, header, header->size);
+    if(0 == size) return NULL;
 
-    header->used = 0;
-    heap_used_size -= header->size;
-    total_frees++;
+    if(size > HEAP_MAX_SIZE || align > HEAP_SEGMENT_MAX) {
+        printf("HEAP ERROR: Aligned allocation of %d bytes (align %d) too large\n", size, align);
+        return NULL;
+    }
 
-    merge_free_block(header);
+    uint32_t total_size = block_size_for(size);
+
+    // 最坏情况下填充接近 align，且填充本身至少要能成为一个最小空闲块
+    uint32_t search_size = total_size + align + HEAP_MIN_BLOCK_SIZE;
+
+    // 新段的块可能落在比 search_size 低的类里，扩展后直接用新段的块
+    struct heap_block_header* block;
+    uint32_t index = find_free_class(request_to_class(search_size));
+    if(index < HEAP_CLASS_COUNT) {
+        block = free_lists[index];
+    }
+    else if(!(block = heap_expand(search_size))) {
+        printf("HEAP ERROR: Out of memory for allocation of %d bytes\n", size);
+        return NULL;
+    }
+
+    free_list_remove(block);
+
+    uint32_t payload = ((uint32_t)block + HEAP_HEADER_SIZE + align - 1) & ~(align - 1);
+    while(payload - HEAP_HEADER_SIZE != (uint32_t)block &&
+          payload - HEAP_HEADER_SIZE - (uint32_t)block < HEAP_MIN_BLOCK_SIZE) {
+        payload += align;
+    }
+
+    uint32_t gap = payload - HEAP_HEADER_SIZE - (uint32_t)block;
+    if(gap) {
+        struct heap_block_header* aligned = payload_block((void*)payload);
+
+        aligned->size = block_size(block) - gap;
+        block->size = gap | HEAP_PREV_USED;
+        set_footer(block);
+        free_list_insert(block);
+
+        aligned_slack += gap;
+        block = aligned;
+    }
+
+    split_block(block, total_size);
+    mark_used(block);
+
+    heap_used_size += block_size(block);
+    total_allocations++;
+    mark_touched(block);
+
+    aligned_allocs++;
+    aligned_waste += block_size(block) - size;
+
+    return (void*)payload;
+}
+
+void* kmalloc_aligned(uint32_t size, uint32_t align)
+{
+    if(align <= HEAP_ALIGNMENT) return kmalloc(size);
+
+    uint64_t start = rdtsc();
+    void* ptr = heap_alloc_aligned(size, align);
+    record_latency(&instr.alloc, rdtsc() - start);
+
+    if(size) instr.size_hist[msb(size)]++;
+    HEAP_TRACE_ALLOC(ptr, size);
+    return ptr;
+}
+
+/* 调整已分配块的大小：能原地扩展或收缩时不拷贝，否则分配新块并搬移数据 */
+void* krealloc(void* ptr, uint32_t size)
+{
+    if(!ptr) return kmalloc(size);
+
+    if(0 == size) {
+        kfree(ptr);
+        return NULL;
+    }
+
+    if(size > HEAP_MAX_SIZE) {
+        printf("HEAP ERROR: Allocation of %d bytes exceeds heap size\n", size);
+        return NULL;
+    }
+
+    struct heap_block_header* block = payload_block(ptr);
+
+    if(!block_used(block)) {
+        printf("HEAP WARNING: krealloc of free block at 0x%x\n", ptr);
+        return NULL;
+    }
+
+    uint32_t total_size = block_size_for(size);
+    uint32_t old_size = block_size(block);
+
+    // 后面紧邻的空闲块足够大时直接吸收，不必搬移
+    struct heap_block_header* next = next_block(block);
+    if(total_size > old_size && !block_used(next) && old_size + block_size(next) >= total_size) {
+        free_list_remove(next);
+        block->size += block_size(next);
+        next_block(block)->size |= HEAP_PREV_USED;
+    }
+
+    if(total_size <= block_size(block)) {
+        // 多出的尾部拆成空闲块，并与其后的空闲块合并
+        if(split_block(block, total_size)) {
+            struct heap_block_header* rest = next_block(block);
+            free_list_remove(rest);
+            merge_free_block(rest);
+        }
+
+        heap_used_size += block_size(block);
+        heap_used_size -= old_size;
+        mark_touched(block);
+        realloc_in_place++;
+
+        // 轨迹中把原地调整记为释放后重新分配
+        HEAP_TRACE_RELEASE(ptr);
+        HEAP_TRACE_ALLOC(ptr, size);
+        return ptr;
+    }
+
+    void* new_ptr = kmalloc(size);
+    if(!new_ptr) return NULL;
+
+    uint32_t payload = old_size - HEAP_HEADER_SIZE;
+    memcpy(new_ptr, ptr, payload);
+    kfree(ptr);
+
+    realloc_moves++;
+    realloc_copied += payload;
+    return new_ptr;
+}
+
+/* 分配并清零；从未分配过的堆内存来自按需清零页，只需清掉空闲链表指针和尾标记 */
+void* kcalloc(uint32_t count, uint32_t size)
+{
+    if(size && count > 0xFFFFFFFF / size) {
+        printf("HEAP ERROR: kcalloc(%d, %d) overflows\n", count, size);
+        return NULL;
+    }
+
+    uint32_t bytes = count * size;
+    uint32_t fresh = heap_fresh_start;
+
+    uint8_t* ptr = (uint8_t*)kmalloc(bytes);
+    if(!ptr) return NULL;
 
+    calloc_calls++;
+
+    struct heap_block_header* block = payload_block(ptr);
+    if((uint32_t)block >= fresh) {
+        uint32_t dirty = sizeof(struct heap_free_links);
+        if(dirty > bytes) dirty = bytes;
+
+        memset(ptr, 0, dirty);
+        *(uint32_t*)((uint8_t*)block + block_size(block) - sizeof(uint32_t)) = 0;
+        calloc_skipped += bytes - dirty;
+    }
+    else {
+        memset(ptr, 0, bytes);
+    }
+
+    return ptr;
 }
 
 void heap_dump(void)
 {
     printf("\n=== Heap Dump ===\n");
     
-    struct heap_block_header* current = heap_start;
     uint32_t block_count = 0;
     uint32_t used_blocks = 0;
     uint32_t free_blocks = 0;
     
-    while (current) {
-        printf("Block %d: 0x%x [%s] size: %d bytes\n",
-               block_count, 
-               (uint8_t*)current + sizeof(struct heap_block_header),
-               current->used ? "USED" : "FREE",
-               current->size - sizeof(struct heap_block_header));
-        
-        if (current->used) used_blocks++;
-        else free_blocks++;
-        
-        block_count++;
-        current = current->next;
+    // 按段遍历，段内靠块大小找到下一块，遇到大小为 0 的栅栏块结束
+    for (uint32_t i = 0; i < segment_count; i++) {
+        struct heap_block_header* current =
+            (struct heap_block_header*)(segments[i].start + HEAP_HEADER_SIZE);
+
+        while (block_size(current)) {
+            printf("Block %d: 0x%x [%s] size: %d bytes\n",
+                   block_count, 
+                   block_payload(current),
+                   block_used(current) ? "USED" : "FREE",
+                   block_size(current) - HEAP_HEADER_SIZE);
+            
+            if (block_used(current)) used_blocks++;
+            else free_blocks++;
+            
+            block_count++;
+            current = next_block(current);
+        }
+
+        printf("---- segment end 0x%x ----\n", segments[i].start + segments[i].size);
     }
     
-    printf("Total blocks: %d (Used: %d, Free: %d)\n", 
-           block_count, used_blocks, free_blocks);
+    printf("Total blocks: %d (Used: %d, Free: %d), segments: %d\n", 
+           block_count, used_blocks, free_blocks, segment_count);
+}
+
+void heap_usage(uint32_t* used, uint32_t* total)
+{
+    *used = heap_used_size;
+    *total = heap_total_size;
 }
 
 void heap_stats(void)
@@ -232,4 +756,197 @@ void heap_stats(void)
     printf("Total allocations:  %d\n", total_allocations);
     printf("Total frees:        %d\n", total_frees);
     printf("Active allocations: %d\n", total_allocations - total_frees);
+    printf("Heap segments:      %d (released %d)\n", segment_count, segment_releases);
+    printf("krealloc:           %d in place, %d moved (%d KB copied)\n",
+           realloc_in_place, realloc_moves, realloc_copied / 1024);
+    printf("kcalloc:            %d calls, %d KB zeroing skipped\n",
+           calloc_calls, calloc_skipped / 1024);
+    printf("kmalloc_aligned:    %d calls, %d KB slack reused, avg waste %d bytes\n",
+           aligned_allocs, aligned_slack / 1024,
+           aligned_allocs ? aligned_waste / aligned_allocs : 0);
+
+    struct page_fault_stats faults;
+    get_page_fault_stats(&faults);
+    printf("Resident pages:     %d (%d KB)\n", faults.resident_pages,
+           faults.resident_pages * PAGE_SIZE / 1024);
+    printf("Page faults:        %d (zero-page %d, demand %d, zero-break %d)\n",
+           faults.total, faults.zero_maps, faults.demand_allocs, faults.zero_breaks);
+}
+
+#define BENCH_MAX_LIVE  100000
+#define BENCH_OPS       1000
+
+/* 活跃块数从 10 增长到 10 万，测量每对 kmalloc/kfree 的平均周期数 */
+void benchmark_kmalloc(void)
+{
+    static const uint32_t targets[] = {10, 100, 1000, 10000, BENCH_MAX_LIVE};
+    uint32_t seed = 12345;
+    uint32_t live = 0;
+
+    void** ptrs = (void**)kmalloc(BENCH_MAX_LIVE * sizeof(void*));
+    if(!ptrs) return;
+
+    printf("\n=== kmalloc Scaling Benchmark ===\n");
+
+    for(uint32_t t = 0; t < sizeof(targets) / sizeof(targets[0]); t++)
+    {
+        while(live < targets[t]) {
+            seed = seed * 1103515245 + 12345;
+            ptrs[live++] = kmalloc(16 + (seed >> 16) % 240);
+        }
+
+        uint64_t alloc_cycles = 0;
+        uint64_t free_cycles = 0;
+
+        // 随机释放一个活跃块再分配一个新块，保持活跃块数不变
+        for(uint32_t op = 0; op < BENCH_OPS; op++) {
+            seed = seed * 1103515245 + 12345;
+            uint32_t victim = (seed >> 8) % live;
+
+            uint64_t start = rdtsc();
+            kfree(ptrs[victim]);
+            free_cycles += rdtsc() - start;
+
+            start = rdtsc();
+            ptrs[victim] = kmalloc(16 + (seed >> 16) % 240);
+            alloc_cycles += rdtsc() - start;
+        }
+
+        printf("  live %6d: kmalloc avg %d cycles, kfree avg %d cycles\n", live,
+               (uint32_t)div_u64(alloc_cycles, BENCH_OPS),
+               (uint32_t)div_u64(free_cycles, BENCH_OPS));
+    }
+
+    for(uint32_t i = 0; i < live; i++) {
+        kfree(ptrs[i]);
+    }
+    kfree(ptrs);
+}
+
+#define BENCH_APPEND_STEP   64
+#define BENCH_APPEND_COUNT  1024
+
+/* 缓冲区每次追加 64 字节增长到 64KB，比较 krealloc 与 kmalloc + 拷贝 + kfree */
+void benchmark_krealloc(void)
+{
+    printf("\n=== krealloc Append Benchmark ===\n");
+
+    uint8_t* buf = NULL;
+    uint32_t naive_copied = 0;
+
+    uint64_t start = rdtsc();
+    for(uint32_t i = 1; i <= BENCH_APPEND_COUNT; i++) {
+        uint8_t* bigger = (uint8_t*)kmalloc(i * BENCH_APPEND_STEP);
+        if(!bigger) break;
+
+        if(buf) {
+            memcpy(bigger, buf, (i - 1) * BENCH_APPEND_STEP);
+            naive_copied += (i - 1) * BENCH_APPEND_STEP;
+            kfree(buf);
+        }
+
+        buf = bigger;
+        memset(buf + (i - 1) * BENCH_APPEND_STEP, (uint8_t)i, BENCH_APPEND_STEP);
+    }
+    uint64_t naive_cycles = rdtsc() - start;
+    kfree(buf);
+
+    buf = NULL;
+    uint32_t moves = realloc_moves;
+    uint32_t copied = realloc_copied;
+
+    start = rdtsc();
+    for(uint32_t i = 1; i <= BENCH_APPEND_COUNT; i++) {
+        uint8_t* bigger = (uint8_t*)krealloc(buf, i * BENCH_APPEND_STEP);
+        if(!bigger) break;
+
+        buf = bigger;
+        memset(buf + (i - 1) * BENCH_APPEND_STEP, (uint8_t)i, BENCH_APPEND_STEP);
+    }
+    uint64_t realloc_cycles = rdtsc() - start;
+    kfree(buf);
+
+    printf("  %d appends of %d bytes\n", BENCH_APPEND_COUNT, BENCH_APPEND_STEP);
+    printf("  kmalloc+copy: %d cycles, %d KB copied\n",
+           (uint32_t)naive_cycles, naive_copied / 1024);
+    printf("  krealloc:     %d cycles, %d KB copied, %d moves\n",
+           (uint32_t)realloc_cycles, (realloc_copied - copied) / 1024, realloc_moves - moves);
+}
+
+/* 由 log2 直方图估计百分位延迟，返回所在桶的上界 */
+uint32_t heap_latency_percentile(const struct heap_latency* latency, uint32_t percent)
+{
+    if(!latency->calls) return 0;
+
+    uint32_t target = (uint32_t)div_u64((uint64_t)latency->calls * percent + 99, 100);
+    uint32_t seen = 0;
+
+    for(uint32_t i = 0; i < HEAP_HIST_BUCKETS; i++) {
+        seen += latency->hist[i];
+        if(seen >= target) {
+            return i == HEAP_HIST_BUCKETS - 1 ? 0xFFFFFFFF : (2U << i) - 1;
+        }
+    }
+
+    return latency->max;
+}
+
+void heap_get_instrumentation(struct heap_instrumentation* stats)
+{
+    memcpy(stats, &instr, sizeof(struct heap_instrumentation));
+
+    stats->free_blocks = 0;
+    stats->free_bytes = 0;
+    stats->largest_free = 0;
+
+    // 只在查询时遍历空闲链表，不增加分配路径的开销
+    for(uint32_t i = 0; i < HEAP_CLASS_COUNT; i++) {
+        for(struct heap_block_header* block = free_lists[i]; block;
+            block = free_links(block)->next_free) {
+            uint32_t size = block_size(block);
+
+            stats->free_blocks++;
+            stats->free_bytes += size;
+            if(size > stats->largest_free) stats->largest_free = size;
+        }
+    }
+
+    stats->fragmentation = stats->free_bytes ?
+        100 - (uint32_t)div_u64((uint64_t)stats->largest_free * 100, stats->free_bytes) : 0;
+}
+
+static void print_latency(const char* name, const struct heap_latency* latency)
+{
+    if(!latency->calls) {
+        printf("%s: no calls\n", name);
+        return;
+    }
+
+    printf("%s: %d calls, min %u, avg %u, max %u, p99 <= %u cycles\n", name,
+           latency->calls, latency->min, (uint32_t)div_u64(latency->total, latency->calls),
+           latency->max, heap_latency_percentile(latency, 99));
+}
+
+void heap_report(void)
+{
+    struct heap_instrumentation stats;
+    heap_get_instrumentation(&stats);
+
+    printf("\n=== Heap Instrumentation ===\n");
+    printf("Request sizes (log2 buckets):\n");
+    for(uint32_t i = 0; i < HEAP_HIST_BUCKETS; i++) {
+        if(stats.size_hist[i]) {
+            printf("  %8u - %8u: %d\n", 1U << i,
+                   i == HEAP_HIST_BUCKETS - 1 ? 0xFFFFFFFF : (2U << i) - 1, stats.size_hist[i]);
+        }
+    }
+
+    print_latency("kmalloc", &stats.alloc);
+    print_latency("kfree  ", &stats.free);
+
+    printf("Free-list search: %d lookups, avg %d steps, max %d\n", stats.searches,
+           stats.searches ? stats.search_steps / stats.searches : 0, stats.max_search_steps);
+    printf("Free blocks: %d, %d KB free, largest %d KB, fragmentation %d%%\n",
+           stats.free_blocks, stats.free_bytes / 1024, stats.largest_free / 1024,
+           stats.fragmentation);
 }
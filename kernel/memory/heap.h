@@ -3,26 +3,106 @@
 
 #include "types.h"
 
-#define HEAP_START  (0x100000)
+/* 堆位于恒等映射之外的虚拟区间，整段预留，按需分配物理帧 */
+#define HEAP_START  (0xE0000000)
 #define HEAP_INIT_SIZE  (0x100000)
-#define HEAP_MAX_SIZE  (0x100000)
+#define HEAP_MAX_SIZE  (0x10000000)
 
-struct heap_block_header
+/* 堆由若干段组成，每段开头 4 字节填充，末尾一个大小为 0 的栅栏块头，合并不会跨段 */
+#define HEAP_MAX_SEGMENTS       32
+#define HEAP_SEGMENT_MAX        (0x1000000)
+#define HEAP_SEGMENT_OVERHEAD   (2 * sizeof(struct heap_block_header))
+
+/* 使用率低于此百分比时，归还堆尾完全空闲的段 */
+#define HEAP_SHRINK_WATERMARK   50
+
+struct heap_segment
 {
+    uint32_t start;
     uint32_t size;
-    uint8_t used;
-    struct heap_block_header* next;
-    struct heap_block_header* prev;
 };
 
 #define HEAP_ALIGNMENT  8
 #define ALIGN(size) (((size) + (HEAP_ALIGNMENT - 1)) & ~(HEAP_ALIGNMENT - 1))
 
+/* 边界标记格式：块头 4 字节，大小按 8 字节对齐，低位存放本块/前一块的使用标志；
+ * 只有空闲块在末尾保存 4 字节尾标记（块大小），相邻块靠地址计算得到 */
+struct heap_block_header
+{
+    uint32_t size;
+};
+
+#define HEAP_BLOCK_USED     0x1
+#define HEAP_PREV_USED      0x2
+#define HEAP_SIZE_MASK      (~(uint32_t)(HEAP_ALIGNMENT - 1))
+
+/* 空闲块的链表指针存放在负载区，已分配块不占用额外空间 */
+struct heap_free_links
+{
+    struct heap_block_header* next_free;
+    struct heap_block_header* prev_free;
+};
+
+/* 最小块必须能在释放后容纳空闲链表指针和尾标记 */
+#define HEAP_MIN_BLOCK_SIZE \
+    ALIGN(sizeof(struct heap_block_header) + sizeof(struct heap_free_links) + sizeof(uint32_t))
+
+/* 大小类：每个 2 的幂区间再均分为 HEAP_SL_COUNT 档 */
+#define HEAP_SL_BITS            2
+#define HEAP_SL_COUNT           (1 << HEAP_SL_BITS)
+#define HEAP_MIN_CLASS_SHIFT    4
+#define HEAP_MIN_CLASS_SIZE     (1 << HEAP_MIN_CLASS_SHIFT)
+#define HEAP_CLASS_COUNT        ((32 - HEAP_MIN_CLASS_SHIFT) * HEAP_SL_COUNT)
+#define HEAP_CLASS_WORDS        ((HEAP_CLASS_COUNT + 31) / 32)
+
+/* 常开的分配器统计：请求大小与调用周期都按 log2 分桶 */
+#define HEAP_HIST_BUCKETS   32
+
+struct heap_latency
+{
+    uint32_t calls;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+    uint32_t hist[HEAP_HIST_BUCKETS];   // 第 i 桶：[2^i, 2^(i+1)) 个周期
+};
+
+struct heap_instrumentation
+{
+    uint32_t size_hist[HEAP_HIST_BUCKETS];  // 第 i 桶：请求大小 [2^i, 2^(i+1))
+    struct heap_latency alloc;
+    struct heap_latency free;
+    uint32_t searches;                  // 空闲链表查找次数
+    uint32_t search_steps;              // 查找累计检查的位图字与链表节点数
+    uint32_t max_search_steps;
+    uint32_t expansions;                // 新建堆段的次数
+
+    // 以下在查询时遍历空闲链表得到
+    uint32_t free_blocks;
+    uint32_t free_bytes;
+    uint32_t largest_free;
+    uint32_t fragmentation;             // 外部碎片率 %：100 - 最大空闲块 / 空闲总量
+};
+
 void heap_init(void);
 void* kmalloc(uint32_t size);
 void kfree(void* ptr);
+void* krealloc(void* ptr, uint32_t size);
+void* kcalloc(uint32_t count, uint32_t size);
+void* kmalloc_aligned(uint32_t size, uint32_t align);
+uint32_t ksize(void* ptr);
+
+/* 按页（4KB）对齐分配 */
+#define kmalloc_page(size)  kmalloc_aligned((size), 0x1000)
+
 void heap_dump(void);
 void heap_stats(void);
+void heap_usage(uint32_t* used, uint32_t* total);
+void heap_get_instrumentation(struct heap_instrumentation* stats);
+uint32_t heap_latency_percentile(const struct heap_latency* latency, uint32_t percent);
+void heap_report(void);
+void benchmark_kmalloc(void);
+void benchmark_krealloc(void);
 
 #define HEAP_DEBUG(mgs, ...)
 
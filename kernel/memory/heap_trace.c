@@ -0,0 +1,219 @@
+#include "heap_trace.h"
+#include "heap.h"
+#include "stdio.h"
+#include "timer.h"
+#include "cpu.h"
+
+static bool replaying = false;
+
+#ifdef HEAP_TRACE
+
+static struct heap_trace_record records[HEAP_TRACE_RECORDS];
+static uint32_t record_head = 0;
+static uint32_t record_count = 0;
+static uint32_t record_dropped = 0;
+
+/* 指针 -> 编号：线性探测哈希表，删除时回移后续项，不留墓碑 */
+struct trace_slot
+{
+    uint32_t ptr;
+    uint16_t id;
+};
+
+static struct trace_slot slots[HEAP_TRACE_HASH_SIZE];
+static uint16_t free_ids[HEAP_TRACE_MAX_LIVE];
+static uint32_t free_id_count = 0;
+static bool trace_ready = false;
+
+static inline uint32_t slot_hash(uint32_t ptr)
+{
+    return ((ptr >> 3) * 2654435761U) & (HEAP_TRACE_HASH_SIZE - 1);
+}
+
+void heap_trace_reset(void)
+{
+    memset(slots, 0, sizeof(slots));
+    for(uint32_t i = 0; i < HEAP_TRACE_MAX_LIVE; i++) {
+        free_ids[i] = HEAP_TRACE_MAX_LIVE - 1 - i;
+    }
+    free_id_count = HEAP_TRACE_MAX_LIVE;
+
+    record_head = 0;
+    record_count = 0;
+    record_dropped = 0;
+    trace_ready = true;
+}
+
+static void trace_append(uint32_t size, uint16_t id)
+{
+    struct heap_trace_record* record = &records[record_head];
+    record->tick = get_ticks();
+    record->size = size;
+    record->id = id;
+
+    record_head = (record_head + 1) % HEAP_TRACE_RECORDS;
+    if(record_count < HEAP_TRACE_RECORDS) record_count++;
+    else record_dropped++;
+}
+
+void heap_trace_alloc(void* ptr, uint32_t size)
+{
+    if(!trace_ready) heap_trace_reset();
+    if(replaying || !ptr) return;
+
+    if(!free_id_count) {
+        record_dropped++;
+        return;
+    }
+
+    uint16_t id = free_ids[--free_id_count];
+    uint32_t index = slot_hash((uint32_t)ptr);
+    while(slots[index].ptr) {
+        index = (index + 1) & (HEAP_TRACE_HASH_SIZE - 1);
+    }
+    slots[index].ptr = (uint32_t)ptr;
+    slots[index].id = id;
+
+    trace_append(size, id);
+}
+
+void heap_trace_free(void* ptr)
+{
+    if(!trace_ready || replaying || !ptr) return;
+
+    uint32_t index = slot_hash((uint32_t)ptr);
+    while(slots[index].ptr && slots[index].ptr != (uint32_t)ptr) {
+        index = (index + 1) & (HEAP_TRACE_HASH_SIZE - 1);
+    }
+
+    // 开始记录之前分配的指针没有编号，忽略
+    if(!slots[index].ptr) return;
+
+    uint16_t id = slots[index].id;
+    free_ids[free_id_count++] = id;
+
+    // 把探测链上后续的项前移，保持查找不断链
+    uint32_t hole = index;
+    uint32_t next = (index + 1) & (HEAP_TRACE_HASH_SIZE - 1);
+    while(slots[next].ptr) {
+        uint32_t home = slot_hash(slots[next].ptr);
+        if(((next - home) & (HEAP_TRACE_HASH_SIZE - 1)) >= ((next - hole) & (HEAP_TRACE_HASH_SIZE - 1))) {
+            slots[hole] = slots[next];
+            hole = next;
+        }
+        next = (next + 1) & (HEAP_TRACE_HASH_SIZE - 1);
+    }
+    slots[hole].ptr = 0;
+
+    trace_append(0, id);
+}
+
+/* 按时间顺序导出轨迹；buffer 为 NULL 时只返回所需字节数，空间不足返回 0 */
+uint32_t heap_trace_dump(void* buffer, uint32_t size)
+{
+    uint32_t bytes = sizeof(struct heap_trace_header) +
+                     record_count * sizeof(struct heap_trace_record);
+
+    if(!buffer) return bytes;
+    if(size < bytes) return 0;
+
+    struct heap_trace_header* header = (struct heap_trace_header*)buffer;
+    header->magic = HEAP_TRACE_MAGIC;
+    header->version = HEAP_TRACE_VERSION;
+    header->record_size = sizeof(struct heap_trace_record);
+    header->count = record_count;
+    header->dropped = record_dropped;
+
+    struct heap_trace_record* out = (struct heap_trace_record*)(header + 1);
+    uint32_t first = (record_head + HEAP_TRACE_RECORDS - record_count) % HEAP_TRACE_RECORDS;
+    for(uint32_t i = 0; i < record_count; i++) {
+        out[i] = records[(first + i) % HEAP_TRACE_RECORDS];
+    }
+
+    return bytes;
+}
+
+#endif
+
+static void update_peak(struct heap_replay_result* result)
+{
+    uint32_t used, total;
+    heap_usage(&used, &total);
+
+    if(used > result->peak_used) result->peak_used = used;
+    if(total > result->peak_total) result->peak_total = total;
+}
+
+/* 用轨迹驱动 kmalloc/kfree，报告吞吐、峰值占用和碎片率；轨迹无效返回 0 */
+int heap_trace_replay(const void* trace, uint32_t bytes, struct heap_replay_result* result)
+{
+    const struct heap_trace_header* header = (const struct heap_trace_header*)trace;
+
+    if(bytes < sizeof(struct heap_trace_header) || header->magic != HEAP_TRACE_MAGIC ||
+       header->version != HEAP_TRACE_VERSION ||
+       header->record_size != sizeof(struct heap_trace_record) ||
+       bytes < sizeof(struct heap_trace_header) + header->count * sizeof(struct heap_trace_record)) {
+        printf("HEAP TRACE ERROR: Invalid trace at 0x%x\n", trace);
+        return 0;
+    }
+
+    void** live = (void**)kcalloc(HEAP_TRACE_MAX_LIVE, sizeof(void*));
+    if(!live) return 0;
+
+    memset(result, 0, sizeof(struct heap_replay_result));
+    replaying = true;
+
+    const struct heap_trace_record* records_in = (const struct heap_trace_record*)(header + 1);
+    for(uint32_t i = 0; i < header->count; i++)
+    {
+        const struct heap_trace_record* record = &records_in[i];
+        uint32_t id = record->id;
+        if(id >= HEAP_TRACE_MAX_LIVE) {
+            result->skipped++;
+            continue;
+        }
+
+        uint64_t start = rdtsc();
+        if(record->size) {
+            if(live[id]) kfree(live[id]);
+            live[id] = kmalloc(record->size);
+            if(!live[id]) result->failed++;
+            result->allocs++;
+        }
+        else if(live[id]) {
+            kfree(live[id]);
+            live[id] = NULL;
+            result->frees++;
+        }
+        else {
+            result->skipped++;
+            continue;
+        }
+        result->cycles += rdtsc() - start;
+        result->ops++;
+
+        update_peak(result);
+    }
+
+    struct heap_instrumentation stats;
+    heap_get_instrumentation(&stats);
+    result->fragmentation = stats.fragmentation;
+
+    for(uint32_t id = 0; id < HEAP_TRACE_MAX_LIVE; id++) {
+        if(live[id]) kfree(live[id]);
+    }
+    kfree(live);
+    replaying = false;
+
+    printf("\n=== Heap Trace Replay ===\n");
+    printf("Records: %d (%d dropped when recorded)\n", header->count, header->dropped);
+    printf("Ops: %d (%d allocs, %d frees, %d failed, %d skipped)\n",
+           result->ops, result->allocs, result->frees, result->failed, result->skipped);
+    printf("Throughput: avg %d cycles/op\n",
+           result->ops ? (uint32_t)div_u64(result->cycles, result->ops) : 0);
+    printf("Peak footprint: %d KB used, %d KB heap\n",
+           result->peak_used / 1024, result->peak_total / 1024);
+    printf("Fragmentation at end: %d%%\n", result->fragmentation);
+
+    return 1;
+}
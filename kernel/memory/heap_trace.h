@@ -0,0 +1,59 @@
+#ifndef HEAP_TRACE_H
+#define HEAP_TRACE_H
+
+#include "types.h"
+
+/* 分配轨迹：以 make HEAP_TRACE=1 编译时记录每次 kmalloc/kfree，可导出后回放 */
+#define HEAP_TRACE_RECORDS      4096    // 环形缓冲区容量，写满后覆盖最旧的记录
+#define HEAP_TRACE_MAX_LIVE     4096    // 同时可跟踪的活跃分配数（指针编号上限）
+#define HEAP_TRACE_HASH_SIZE    (2 * HEAP_TRACE_MAX_LIVE)
+#define HEAP_TRACE_MAGIC        0x43525448  // "HTRC"
+#define HEAP_TRACE_VERSION      1
+
+/* 一条记录 10 字节；size 为 0 表示释放编号为 id 的分配 */
+struct heap_trace_record
+{
+    uint32_t tick;
+    uint32_t size;
+    uint16_t id;
+} __attribute__((packed));
+
+/* 导出的二进制轨迹：文件头后紧跟按时间顺序排列的记录 */
+struct heap_trace_header
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t count;
+    uint32_t dropped;           // 因环形缓冲区覆盖或编号用尽而丢失的记录数
+} __attribute__((packed));
+
+struct heap_replay_result
+{
+    uint32_t ops;
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t failed;            // 回放时 kmalloc 失败
+    uint32_t skipped;           // 释放了轨迹窗口之前分配的编号
+    uint64_t cycles;
+    uint32_t peak_used;         // 回放期间堆已用字节的峰值
+    uint32_t peak_total;        // 回放期间堆总大小的峰值
+    uint32_t fragmentation;     // 回放结束时的外部碎片率 %
+};
+
+#ifdef HEAP_TRACE
+void heap_trace_alloc(void* ptr, uint32_t size);
+void heap_trace_free(void* ptr);
+void heap_trace_reset(void);
+uint32_t heap_trace_dump(void* buffer, uint32_t size);
+
+#define HEAP_TRACE_ALLOC(ptr, size)     heap_trace_alloc((ptr), (size))
+#define HEAP_TRACE_RELEASE(ptr)         heap_trace_free(ptr)
+#else
+#define HEAP_TRACE_ALLOC(ptr, size)
+#define HEAP_TRACE_RELEASE(ptr)
+#endif
+
+int heap_trace_replay(const void* trace, uint32_t bytes, struct heap_replay_result* result);
+
+#endif
@@ -2,25 +2,113 @@
 
 #include "stdio.h"
 #include "interrupt.h"
+#include "cpu.h"
+#include "buddy.h"
+#include "heap.h"
+#include "shrinker.h"
+
+#define INVALID_FRAME 0xFFFFFFFF
 
 static uint32_t total_memory = 0;
-// static uint32_t usable_memory = 0;
-// static struct memory_region* memory_map = (struct memory_region*)(0x5000);
-// static uint32_t memory_map_entries = 0;
+static struct memory_region* memory_map = (struct memory_region*)(MEMORY_MAP_ADDR);
+static uint32_t memory_map_entries = 0;
+static struct memory_region fallback_region;
 
-static uint8_t bitmap[BITMAP_SIZE] = {0};
+static uint32_t* bitmap = NULL;
+static uint32_t bitmap_words = 0;
 static uint32_t total_frames = 0;
+static uint32_t reserved_frames = 0;
 static uint32_t used_frames = 0;
 static uint32_t bitmap_start_addr = 0;
 
+/* 每个分区覆盖位图中连续的整字，单独统计空闲帧并保存自己的扫描提示 */
+struct memory_zone
+{
+    const char* name;
+    uint32_t first_word;        // 覆盖位图字 [first_word, end_word)
+    uint32_t end_word;
+    uint32_t free_frames;
+    uint32_t next_free_word;    // 滚动提示：此前的字都已占满
+    uint32_t allocs;
+    uint32_t fallbacks;         // 普通分配因高端内存用尽而落到本区的次数
+};
+
+static struct memory_zone zones[ZONE_COUNT] = {
+    {"DMA", 0, 0, 0, 0, 0, 0},
+    {"Normal", 0, 0, 0, 0, 0, 0},
+};
+
+static uint32_t alloc_calls = 0;
+static uint64_t alloc_cycles = 0;
+
+static uint32_t zero_pool[ZERO_POOL_SIZE];
+static uint32_t zero_pool_count = 0;
+static uint32_t zero_pool_hits = 0;
+static uint32_t zero_pool_misses = 0;
+static uint32_t zero_pool_refills = 0;
+static bool has_movnti = false;
+static struct shrinker zero_pool_shrinker;
+
+static const char* region_type_name(uint32_t type)
+{
+    switch(type) {
+    case E820_USABLE:       return "Usable";
+    case E820_RESERVED:     return "Reserved";
+    case E820_ACPI_RECLAIM: return "ACPI Reclaim";
+    case E820_ACPI_NVS:     return "ACPI NVS";
+    case E820_BAD:          return "Bad";
+    default:                return "Unknown";
+    }
+}
+
+/* 把区域裁剪到 4GB 以内，返回 [start, end) */
+static bool region_bounds(const struct memory_region* region, uint32_t* start, uint32_t* end)
+{
+    uint64_t base = region->base_addr;
+    uint64_t limit = region->base_addr + region->length;
+
+    if(0 == region->length || base >= MEMORY_LIMIT) return false;
+    if(limit > MEMORY_LIMIT) limit = MEMORY_LIMIT;
+
+    *start = (uint32_t)base;
+    *end = (uint32_t)limit;
+    return true;
+}
+
+/* 读取引导程序保存的 E820 内存布局，BIOS 不支持时按 KERNEL_MEMORY_MB 回退 */
 void detect_memory(void)
 {
-    printf("Memory Configuration:\n");
-    printf("  Compiled for: %d MB\n", KERNEL_MEMORY_MB);
-    printf("  Total memory: %d MB\n", TOTAL_MEMORY / (1024*1024));
-    printf("  Usable memory: %d MB (above 1MB)\n", USABLE_MEMORY / (1024*1024));
+    memory_map_entries = *(uint16_t*)MEMORY_MAP_COUNT_ADDR;
+
+    if(0 == memory_map_entries || memory_map_entries > MEMORY_MAP_MAX) {
+        fallback_region.base_addr = 0;
+        fallback_region.length = KERNEL_MEMORY_MB * 1024 * 1024;
+        fallback_region.type = E820_USABLE;
+        fallback_region.acpi_attr = 1;
+
+        memory_map = &fallback_region;
+        memory_map_entries = 1;
+        printf("WARNING: No E820 memory map, assuming %d MB\n", KERNEL_MEMORY_MB);
+    }
+
+    printf("Memory Map (%d entries):\n", memory_map_entries);
+
+    total_memory = 0;
+    for(uint32_t i = 0; i < memory_map_entries; i++)
+    {
+        struct memory_region* region = &memory_map[i];
+        uint32_t start, end;
+
+        printf("  0x%x - %d KB [%s]\n", (uint32_t)region->base_addr,
+               (uint32_t)(region->length >> 10), region_type_name(region->type));
+
+        if(E820_USABLE == region->type && region_bounds(region, &start, &end)) {
+            if(end > total_memory) total_memory = end & ~(PAGE_SIZE - 1);
+        }
+    }
+
+    printf("  Total memory: %d MB\n", total_memory / (1024*1024));
     printf("  Page size: %d bytes\n", PAGE_SIZE);
-    printf("  Total pages: %d\n", USABLE_MEMORY / PAGE_SIZE);
 }
 
 void memory_init(void)
@@ -29,18 +117,20 @@ void memory_init(void)
 
     detect_memory();
 
-    if (KERNEL_MEMORY_MB < 16) {
-        printf("WARNING: Memory configuration < 16MB may be insufficient\n");
-    }
-    
-    if (KERNEL_MEMORY_MB > 512) {
-        printf("WARNING: Memory configuration > 512MB may be unrealistic\n");
+    if (total_memory < 16 * 1024 * 1024) {
+        printf("WARNING: Memory < 16MB may be insufficient\n");
     }
 
     init_bitmap_allocator();
+    buddy_init();
+
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    has_movnti = (edx & CPUID_FEAT_EDX_SSE2) != 0;
+    register_shrinker(&zero_pool_shrinker);
     // init_kernel_heap();
 
-    printf("Memory management initialized for %d MB system\n", KERNEL_MEMORY_MB);
+    printf("Memory management initialized for %d MB system\n", get_kernel_memory_mb());
 }
 
 uint32_t get_total_memory(void)
@@ -50,67 +140,287 @@ uint32_t get_total_memory(void)
 
 uint32_t get_usable_memory(void)
 {
-    return USABLE_MEMORY;
+    return (total_frames - reserved_frames) * PAGE_SIZE;
 }
 
 uint32_t get_kernel_memory_mb(void)
 {
-    return KERNEL_MEMORY_MB;
+    return total_memory / (1024 * 1024);
+}
+
+uint32_t get_free_frames(void)
+{
+    return total_frames - reserved_frames - used_frames;
+}
+
+uint32_t get_zone_free_frames(uint32_t zone)
+{
+    return zone < ZONE_COUNT ? zones[zone].free_frames : 0;
+}
+
+static inline struct memory_zone* frame_zone(uint32_t index)
+{
+    return (index / BITS_PER_WORD < zones[ZONE_NORMAL].first_word) ? &zones[ZONE_DMA] : &zones[ZONE_NORMAL];
+}
+
+/* 16MB 边界在位图中正好是整字（(16MB - 1MB) / 4KB = 3840 = 120 * 32） */
+static void init_zones(void)
+{
+    uint32_t dma_words = (ZONE_DMA_LIMIT - USABLE_MEM_START) / PAGE_SIZE / BITS_PER_WORD;
+    if(dma_words > bitmap_words) dma_words = bitmap_words;
+
+    zones[ZONE_DMA].first_word = 0;
+    zones[ZONE_DMA].end_word = dma_words;
+    zones[ZONE_NORMAL].first_word = dma_words;
+    zones[ZONE_NORMAL].end_word = bitmap_words;
+
+    for(uint32_t z = 0; z < ZONE_COUNT; z++)
+    {
+        struct memory_zone* zone = &zones[z];
+        zone->free_frames = 0;
+        zone->next_free_word = zone->first_word;
+        zone->allocs = 0;
+        zone->fallbacks = 0;
+
+        uint32_t end = zone->end_word * BITS_PER_WORD;
+        if(end > total_frames) end = total_frames;
+        for(uint32_t i = zone->first_word * BITS_PER_WORD; i < end; i++) {
+            if(!test_bitmap(i)) zone->free_frames++;
+        }
+    }
+}
+
+/* 按标志选择分区：DMA 请求只用 DMA 区；普通请求先用高端内存，用尽后才动 DMA 区且不碰保留帧 */
+static struct memory_zone* pick_zone(uint32_t flags, uint32_t count)
+{
+    struct memory_zone* dma = &zones[ZONE_DMA];
+    struct memory_zone* normal = &zones[ZONE_NORMAL];
+
+    if(flags & ALLOC_DMA) {
+        return dma->free_frames >= count ? dma : NULL;
+    }
+
+    if(normal->free_frames >= count) {
+        return normal;
+    }
+
+    if(dma->free_frames >= count + ZONE_DMA_RESERVE) {
+        dma->fallbacks++;
+        return dma;
+    }
+
+    return NULL;
+}
+
+static void mark_range(uint32_t start, uint32_t end, bool used)
+{
+    if(end <= USABLE_MEM_START) return;
+    if(start < USABLE_MEM_START) start = USABLE_MEM_START;
+
+    // 可用区域向内取整，保留区域向外取整
+    uint32_t first, last;
+    if(used) {
+        first = (start - USABLE_MEM_START) / PAGE_SIZE;
+        last = (end - USABLE_MEM_START + PAGE_SIZE - 1) / PAGE_SIZE;
+    }
+    else {
+        first = (start - USABLE_MEM_START + PAGE_SIZE - 1) / PAGE_SIZE;
+        last = (end - USABLE_MEM_START) / PAGE_SIZE;
+    }
+
+    if(last > total_frames) last = total_frames;
+
+    for(uint32_t i = first; i < last; i++) {
+        if(used) set_bitmap(i);
+        else clear_bitmap(i);
+    }
+}
+
+/* 在第一个能容纳 size 字节的可用区域中放置位图 */
+static uint32_t place_bitmap(uint32_t size)
+{
+    for(uint32_t i = 0; i < memory_map_entries; i++)
+    {
+        uint32_t start, end;
+        if(E820_USABLE != memory_map[i].type || !region_bounds(&memory_map[i], &start, &end)) {
+            continue;
+        }
+
+        if(start < USABLE_MEM_START) start = USABLE_MEM_START;
+        start = (start + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+
+        if(start < end && end - start >= size) {
+            return start;
+        }
+    }
+
+    return 0;
 }
 
 void init_bitmap_allocator(void)
 {
     printf("Initializing bitmap allocator...\n");
 
-    total_frames = USABLE_MEMORY / PAGE_SIZE;
+    total_frames = (total_memory - USABLE_MEM_START) / PAGE_SIZE;
+    bitmap_words = (total_frames + BITS_PER_WORD - 1) / BITS_PER_WORD;
 
-    memset(bitmap, 0, BITMAP_SIZE);
+    uint32_t bitmap_size = bitmap_words * sizeof(uint32_t);
+    bitmap_start_addr = place_bitmap(bitmap_size);
+    if(!bitmap_start_addr) {
+        printf("ERROR: No usable region for %d byte frame bitmap\n", bitmap_size);
+        total_frames = 0;
+        return;
+    }
 
-    bitmap_start_addr = (uint32_t)&bitmap[0];
-    uint32_t bitmap_end_addr = bitmap_start_addr + BITMAP_SIZE;
+    bitmap = (uint32_t*)bitmap_start_addr;
+    used_frames = 0;
 
-    uint32_t first_bitmap_frame = (bitmap_start_addr - USABLE_MEM_START) / PAGE_SIZE;
-    uint32_t last_bitmap_frame = (bitmap_end_addr - USABLE_MEM_START) / PAGE_SIZE;
+    // 先全部置为占用，再放开可用区域，最后重新扣除与之重叠的保留区域
+    memset(bitmap, 0xFF, bitmap_size);
 
-    for(uint32_t i = first_bitmap_frame; i <= last_bitmap_frame; i++)
+    for(uint32_t pass = 0; pass < 2; pass++)
     {
-        if(i < total_frames){
-            set_bitmap(i);
-            used_frames++;
+        for(uint32_t i = 0; i < memory_map_entries; i++)
+        {
+            uint32_t start, end;
+            bool usable = (E820_USABLE == memory_map[i].type);
+
+            if(usable == (0 == pass) && region_bounds(&memory_map[i], &start, &end)) {
+                mark_range(start, end, !usable);
+            }
         }
     }
 
+    reserved_frames = 0;
+    for(uint32_t i = 0; i < total_frames; i++) {
+        if(test_bitmap(i)) reserved_frames++;
+    }
+
+    // 位图本身所在的帧计为已用
+    uint32_t bitmap_end_addr = bitmap_start_addr + bitmap_size;
+    uint32_t first_bitmap_frame = (bitmap_start_addr - USABLE_MEM_START) / PAGE_SIZE;
+    uint32_t last_bitmap_frame = (bitmap_end_addr - 1 - USABLE_MEM_START) / PAGE_SIZE;
+
+    mark_range(bitmap_start_addr, bitmap_end_addr, true);
+
+    uint32_t marked = 0;
+    for(uint32_t i = 0; i < total_frames; i++) {
+        if(test_bitmap(i)) marked++;
+    }
+    used_frames = marked - reserved_frames;
+
+    init_zones();
+
     printf("Bitmap allocator initialized:\n");
-    printf("  Total frames: %d\n", total_frames);
-    printf("  Bitmap size: %d bytes (%d pages)\n", BITMAP_SIZE, (last_bitmap_frame - first_bitmap_frame + 1));
+    printf("  Total frames: %d (%d reserved)\n", total_frames, reserved_frames);
+    printf("  Bitmap at 0x%x, size: %d bytes (%d pages)\n", bitmap_start_addr,
+           bitmap_size, (last_bitmap_frame - first_bitmap_frame + 1));
     printf("  Used frames: %d\n", used_frames);
-    printf("  Free frames: %d\n", total_frames - used_frames);
+    printf("  Free frames: %d (DMA %d, Normal %d)\n", get_free_frames(),
+           zones[ZONE_DMA].free_frames, zones[ZONE_NORMAL].free_frames);
 }
-uint32_t allocate_frame(void)
+
+/* 在分区内从滚动提示开始按字扫描，跳过全满的字，用 bsf 定位空闲位 */
+static uint32_t find_free_frame(struct memory_zone* zone)
 {
-    for(uint32_t i = 0; i < total_frames; i++)
+    uint32_t word = zone->next_free_word;
+
+    for(uint32_t n = zone->first_word; n < zone->end_word; n++)
     {
-        if(!test_bitmap(i)) {
-            set_bitmap(i);
-            used_frames++;
+        if(bitmap[word] != BITMAP_FULL_WORD) {
+            zone->next_free_word = word;
+            return word * BITS_PER_WORD + bit_scan_forward(~bitmap[word]);
+        }
+
+        if(++word == zone->end_word) {
+            word = zone->first_word;
+        }
+    }
 
-            uint32_t physical_addr = USABLE_MEM_START + (i * PAGE_SIZE);
+    return INVALID_FRAME;
+}
 
-            return physical_addr;
+/* 按 flags（ALLOC_NORMAL / ALLOC_DMA / ALLOC_NORECLAIM）分配一个帧，返回物理地址；失败返回 0 */
+uint32_t alloc_frame_zone(uint32_t flags)
+{
+    uint64_t start = rdtsc();
+    struct memory_zone* zone = pick_zone(flags, 1);
+
+    // 分配失败前先让持有缓存的子系统交出内存，再试一次
+    if(!zone && !(flags & ALLOC_NORECLAIM) && shrink_memory(1, SHRINK_DIRECT)) {
+        zone = pick_zone(flags, 1);
+    }
+
+    uint32_t index = zone ? find_free_frame(zone) : INVALID_FRAME;
+
+    if(INVALID_FRAME == index) {
+        printf("Error: Out of memory! No free %sframes available.\n",
+               (flags & ALLOC_DMA) ? "DMA " : "");
+        return 0;
+    }
+
+    set_bitmap(index);
+    used_frames++;
+    zone->free_frames--;
+    zone->allocs++;
+
+    alloc_cycles += rdtsc() - start;
+    alloc_calls++;
+
+    return USABLE_MEM_START + (index * PAGE_SIZE);
+}
+
+uint32_t allocate_frame(void)
+{
+    return alloc_frame_zone(ALLOC_NORMAL);
+}
+
+/* 帧是否从未交给分配器：E820 保留区域（向外取整）、可用区域之外的空洞，以及位图本身 */
+static bool frame_reserved(uint32_t addr)
+{
+    uint32_t bitmap_end = bitmap_start_addr + bitmap_words * sizeof(uint32_t);
+    if(addr + PAGE_SIZE > bitmap_start_addr && addr < bitmap_end) return true;
+
+    bool usable = false;
+    for(uint32_t i = 0; i < memory_map_entries; i++)
+    {
+        uint32_t start, end;
+        if(!region_bounds(&memory_map[i], &start, &end)) continue;
+
+        if(E820_USABLE != memory_map[i].type) {
+            if(addr < end && addr + PAGE_SIZE > start) return true;
+        }
+        else if(addr >= start && addr + PAGE_SIZE <= end) {
+            usable = true;
         }
     }
 
-    printf("Error: Out of memory! No free frames available.\n");
-    return 0;
+    return !usable;
 }
 
 void free_frame(uint32_t frame_index)
 {
     uint32_t index = (frame_index - USABLE_MEM_START) / PAGE_SIZE;
+
+    // 保留帧和伙伴池中的帧不归位图管理，与伙伴系统拒绝池外地址一样直接拒绝
+    if(index < total_frames && (frame_reserved(frame_index & ~(PAGE_SIZE - 1)) ||
+                                buddy_owns(frame_index))) {
+        printf("ERROR: Free of %s frame 0x%x rejected\n",
+               buddy_owns(frame_index) ? "buddy pool" : "reserved", frame_index);
+        return;
+    }
+
     if(index < total_frames) {
         if(test_bitmap(index)) {
+            struct memory_zone* zone = frame_zone(index);
+
             clear_bitmap(index);
             used_frames--;
+            zone->free_frames++;
+
+            if(index / BITS_PER_WORD < zone->next_free_word) {
+                zone->next_free_word = index / BITS_PER_WORD;
+            }
         }
         else {
             printf("WARNING: Double free detected at frame %d\n", index);
@@ -120,52 +430,385 @@ void free_frame(uint32_t frame_index)
         printf("ERROR: Invalid frame index %d\n", index);
     }
 }
+
+/* 从分区中按字取出 count 个空闲帧，调用者保证分区内空闲帧足够 */
+static void zone_take_frames(struct memory_zone* zone, uint32_t count, uint32_t* frames)
+{
+    uint32_t word = zone->next_free_word;
+    uint32_t got = 0;
+
+    while(got < count)
+    {
+        uint32_t free_bits = ~bitmap[word];
+
+        while(free_bits && got < count) {
+            uint32_t bit = bit_scan_forward(free_bits);
+            free_bits &= free_bits - 1;
+            frames[got++] = USABLE_MEM_START + (word * BITS_PER_WORD + bit) * PAGE_SIZE;
+        }
+
+        bitmap[word] = ~free_bits;
+
+        if(got < count && ++word == zone->end_word) {
+            word = zone->first_word;
+        }
+    }
+
+    zone->next_free_word = word;
+    zone->free_frames -= count;
+    zone->allocs += count;
+    used_frames += count;
+}
+
+/* 批量分配可用的帧数：高端内存加上 DMA 区保留帧之外的部分 */
+static uint32_t bulk_available(void)
+{
+    uint32_t dma_free = zones[ZONE_DMA].free_frames;
+    uint32_t dma_spare = dma_free > ZONE_DMA_RESERVE ? dma_free - ZONE_DMA_RESERVE : 0;
+
+    return zones[ZONE_NORMAL].free_frames + dma_spare;
+}
+
+/* 一次扫描分配 count 个帧（不保证物理连续），物理地址写入 frames；全部成功返回 count，否则返回 0。
+ * 先取高端内存，不够的部分再从 DMA 区补足 */
+uint32_t allocate_frames_bulk(uint32_t count, uint32_t* frames)
+{
+    struct memory_zone* dma = &zones[ZONE_DMA];
+    struct memory_zone* normal = &zones[ZONE_NORMAL];
+
+    if(count > bulk_available()) {
+        shrink_memory(count - bulk_available(), SHRINK_DIRECT);
+    }
+
+    if(count > bulk_available()) {
+        printf("Error: Out of memory! %d frames requested, %d free.\n",
+               count, get_free_frames());
+        return 0;
+    }
+
+    uint64_t start = rdtsc();
+    uint32_t high = count < normal->free_frames ? count : normal->free_frames;
+
+    zone_take_frames(normal, high, frames);
+    if(count > high) {
+        zone_take_frames(dma, count - high, frames + high);
+        dma->fallbacks++;
+    }
+
+    alloc_cycles += rdtsc() - start;
+    alloc_calls++;
+
+    return count;
+}
+
+void free_frames_bulk(uint32_t count, const uint32_t* frames)
+{
+    for(uint32_t i = 0; i < count; i++) {
+        free_frame(frames[i]);
+    }
+}
+
+/* 检查 [first, first + count) 是否全部空闲，整字对齐的部分按字比较 */
+static bool frame_range_free(uint32_t first, uint32_t count)
+{
+    uint32_t i = first;
+    uint32_t end = first + count;
+
+    while(i < end)
+    {
+        if(0 == i % BITS_PER_WORD && i + BITS_PER_WORD <= end) {
+            if(bitmap[i / BITS_PER_WORD]) return false;
+            i += BITS_PER_WORD;
+        }
+        else {
+            if(test_bitmap(i)) return false;
+            i++;
+        }
+    }
+
+    return true;
+}
+
+/* 在分区内查找 count 个连续空闲帧，起始物理地址按 align 字节对齐 */
+static uint32_t zone_find_range(struct memory_zone* zone, uint32_t count, uint32_t align)
+{
+    uint32_t zone_start = USABLE_MEM_START + zone->first_word * BITS_PER_WORD * PAGE_SIZE;
+    uint32_t zone_end = zone->end_word * BITS_PER_WORD;
+    uint32_t addr = (zone_start + align - 1) & ~(align - 1);
+    uint32_t step = align / PAGE_SIZE;
+
+    if(zone_end > total_frames) zone_end = total_frames;
+
+    for(uint32_t first = (addr - USABLE_MEM_START) / PAGE_SIZE;
+        first + count <= zone_end; first += step)
+    {
+        if(frame_range_free(first, count)) {
+            return first;
+        }
+    }
+
+    return INVALID_FRAME;
+}
+
+/* 按 flags 选择分区并查找连续区间，找到时 *found 为所在分区 */
+static uint32_t pick_range(uint32_t count, uint32_t align, uint32_t flags, struct memory_zone** found)
+{
+    struct memory_zone* zone = (flags & ALLOC_DMA) ? &zones[ZONE_DMA] : &zones[ZONE_NORMAL];
+    uint32_t first = zone->free_frames >= count ? zone_find_range(zone, count, align) : INVALID_FRAME;
+
+    // 普通请求在高端内存找不到连续区间时回退到 DMA 区，同样不碰保留帧
+    if(INVALID_FRAME == first && !(flags & ALLOC_DMA) &&
+       zones[ZONE_DMA].free_frames >= count + ZONE_DMA_RESERVE) {
+        zone = &zones[ZONE_DMA];
+        first = zone_find_range(zone, count, align);
+        if(INVALID_FRAME != first) zone->fallbacks++;
+    }
+
+    *found = zone;
+    return first;
+}
+
+/* 按 flags 分配 count 个物理连续的帧，起始物理地址按 align 字节对齐；失败返回 0 */
+uint32_t alloc_frame_range_zone(uint32_t count, uint32_t align, uint32_t flags)
+{
+    if(0 == count) {
+        return 0;
+    }
+
+    if(align < PAGE_SIZE) align = PAGE_SIZE;
+
+    struct memory_zone* zone;
+    uint32_t first = pick_range(count, align, flags, &zone);
+
+    if(INVALID_FRAME == first && !(flags & ALLOC_NORECLAIM) && shrink_memory(count, SHRINK_DIRECT)) {
+        first = pick_range(count, align, flags, &zone);
+    }
+
+    if(INVALID_FRAME == first) {
+        return 0;
+    }
+
+    for(uint32_t i = first; i < first + count; i++) {
+        set_bitmap(i);
+    }
+    used_frames += count;
+    zone->free_frames -= count;
+    zone->allocs += count;
+
+    return USABLE_MEM_START + first * PAGE_SIZE;
+}
+
+uint32_t allocate_frame_range(uint32_t count, uint32_t align)
+{
+    return alloc_frame_range_zone(count, align, ALLOC_NORMAL);
+}
+
+void free_frame_range(uint32_t addr, uint32_t count)
+{
+    for(uint32_t i = 0; i < count; i++) {
+        free_frame(addr + i * PAGE_SIZE);
+    }
+}
+
+/* rep stosd 清零一页，清零后的内容留在缓存里，适合马上就要使用的帧 */
+static inline void zero_frame(uint32_t addr)
+{
+    uint32_t count = PAGE_SIZE / sizeof(uint32_t);
+    asm volatile("rep stosl" : "+D"(addr), "+c"(count) : "a"(0) : "memory");
+}
+
+/* movnti 非临时存储清零一页，不把池中暂时用不到的帧挤进缓存 */
+static inline void zero_frame_nocache(uint32_t addr)
+{
+    for(uint32_t end = addr + PAGE_SIZE; addr < end; addr += 4 * sizeof(uint32_t)) {
+        asm volatile("movnti %1, (%0)\n\t"
+                     "movnti %1, 4(%0)\n\t"
+                     "movnti %1, 8(%0)\n\t"
+                     "movnti %1, 12(%0)"
+                     : : "r"(addr), "r"(0) : "memory");
+    }
+    asm volatile("sfence" : : : "memory");
+}
+
+/* 分配一个内容全零的帧：优先取预清零池，池空时同步清零 */
+uint32_t allocate_zeroed_frame(void)
+{
+    if(zero_pool_count) {
+        zero_pool_hits++;
+        return zero_pool[--zero_pool_count];
+    }
+
+    uint32_t frame = allocate_frame();
+    if(frame) {
+        zero_pool_misses++;
+        zero_frame(frame);
+    }
+    return frame;
+}
+
+/* 空闲循环中调用：每次最多清零 ZERO_POOL_BATCH 帧补充到池中，内存紧张时不补充 */
+void refill_zero_pool(void)
+{
+    for(uint32_t n = 0; n < ZERO_POOL_BATCH && zero_pool_count < ZERO_POOL_SIZE; n++)
+    {
+        if(memory_low()) return;
+
+        uint32_t frame = allocate_frame();
+        if(!frame) return;
+
+        if(has_movnti) zero_frame_nocache(frame);
+        else zero_frame(frame);
+
+        zero_pool[zero_pool_count++] = frame;
+        zero_pool_refills++;
+    }
+}
+
+/* 池中的帧随时可以交还 */
+static uint32_t zero_pool_count_pages(void* ctx)
+{
+    (void)ctx;
+    return zero_pool_count;
+}
+
+static uint32_t zero_pool_scan(void* ctx, uint32_t pages, uint32_t flags)
+{
+    (void)ctx;
+    (void)flags;
+    uint32_t freed = 0;
+
+    while(zero_pool_count && freed < pages) {
+        free_frame(zero_pool[--zero_pool_count]);
+        freed++;
+    }
+    return freed;
+}
+
+static struct shrinker zero_pool_shrinker = {
+    "zero_pool", zero_pool_count_pages, zero_pool_scan, NULL, 0, 0, NULL
+};
+
 void print_bitmap_stats(void)
 {
-    uint32_t free_frames = total_frames - used_frames;
+    uint32_t usable_frames = total_frames - reserved_frames;
+    uint32_t free_frames = get_free_frames();
     uint32_t free_memory = free_frames * PAGE_SIZE;
     uint32_t used_memory = used_frames * PAGE_SIZE;
     
     printf("Memory Statistics:\n");
-    printf("  Total frames: %d (%d MB)\n", total_frames, total_frames * PAGE_SIZE / (1024*1024));
+    printf("  Total frames: %d (%d MB)\n", usable_frames, usable_frames * PAGE_SIZE / (1024*1024));
     printf("  Used frames: %d (%d KB)\n", used_frames, used_memory / 1024);
     printf("  Free frames: %d (%d KB)\n", free_frames, free_memory / 1024);
-    printf("  Memory usage: %d%%\n", (used_frames * 100) / total_frames);
+    printf("  Memory usage: %d%%\n", usable_frames ? (used_frames * 100) / usable_frames : 0);
+    printf("  Alloc calls: %d, avg %d cycles\n", alloc_calls,
+           alloc_calls ? (uint32_t)div_u64(alloc_cycles, alloc_calls) : 0);
+
+    uint32_t zeroed = zero_pool_hits + zero_pool_misses;
+    printf("  Zero pool: %d/%d frames, %d hits, %d misses (%d%% hit rate), %d refilled%s\n",
+           zero_pool_count, ZERO_POOL_SIZE, zero_pool_hits, zero_pool_misses,
+           zeroed ? zero_pool_hits * 100 / zeroed : 0, zero_pool_refills,
+           has_movnti ? " with movnti" : "");
+
+    for(uint32_t z = 0; z < ZONE_COUNT; z++) {
+        const struct memory_zone* zone = &zones[z];
+        printf("  Zone %s: 0x%x - 0x%x, free %d, allocs %d, fallbacks %d\n", zone->name,
+               USABLE_MEM_START + zone->first_word * BITS_PER_WORD * PAGE_SIZE,
+               USABLE_MEM_START + zone->end_word * BITS_PER_WORD * PAGE_SIZE,
+               zone->free_frames, zone->allocs, zone->fallbacks);
+    }
+}
+
+/* 旧实现：从分区第一个帧逐位扫描，仅用于基准对比 */
+static uint32_t find_free_frame_linear(const struct memory_zone* zone)
+{
+    for(uint32_t i = zone->first_word * BITS_PER_WORD; i < total_frames; i++)
+    {
+        if(!test_bitmap(i)) {
+            return i;
+        }
+    }
+
+    return INVALID_FRAME;
+}
+
+#define BENCH_FILL_FRAMES   2048
+#define BENCH_ROUNDS        64
+
+/* 低端帧基本用满时，对比逐位扫描 / 按字扫描 / 按字扫描+提示 的单次分配周期数 */
+void benchmark_frame_allocator(void)
+{
+    static uint32_t fill[BENCH_FILL_FRAMES];
+    struct memory_zone* zone = zones[ZONE_NORMAL].free_frames ? &zones[ZONE_NORMAL] : &zones[ZONE_DMA];
+    uint32_t picked[BENCH_ROUNDS];
+    uint64_t cycles[3] = {0, 0, 0};
+    const char* names[3] = {"Bit-by-bit scan", "Word scan (no hint)", "Word scan + hint"};
+
+    uint32_t fill_count = get_free_frames() / 2;
+    if(fill_count > BENCH_FILL_FRAMES) fill_count = BENCH_FILL_FRAMES;
+
+    if(!allocate_frames_bulk(fill_count, fill)) {
+        return;
+    }
+
+    for(int mode = 0; mode < 3; mode++)
+    {
+        for(int r = 0; r < BENCH_ROUNDS; r++) {
+            if(1 == mode) zone->next_free_word = zone->first_word;
+
+            uint64_t start = rdtsc();
+            picked[r] = (0 == mode) ? find_free_frame_linear(zone) : find_free_frame(zone);
+            cycles[mode] += rdtsc() - start;
+
+            set_bitmap(picked[r]);
+        }
+
+        for(int r = 0; r < BENCH_ROUNDS; r++) {
+            clear_bitmap(picked[r]);
+        }
+        zone->next_free_word = zone->first_word;
+    }
+
+    free_frames_bulk(fill_count, fill);
+
+    printf("Frame allocator benchmark (%d frames pre-filled, %d rounds):\n", fill_count, BENCH_ROUNDS);
+    for(int mode = 0; mode < 3; mode++) {
+        printf("  %s: avg %d cycles\n", names[mode], (uint32_t)div_u64(cycles[mode], BENCH_ROUNDS));
+    }
 }
 
 void init_kernel_heap(void)
 {
-    printf("Kernel heap: TODO - starting at 0x%x\n", KERNEL_HEAP_START);
+    printf("Kernel heap: see heap_init() - starting at 0x%x\n", HEAP_START);
 }
 
 void set_bitmap(uint32_t bit)
 {
-    uint32_t byte_index = bit  / BITS_PER_BYTE;
-    uint32_t bit_index = bit % BITS_PER_BYTE;
+    uint32_t word_index = bit / BITS_PER_WORD;
+    uint32_t bit_index = bit % BITS_PER_WORD;
 
-    if(byte_index < BITMAP_SIZE) {
-        bitmap[byte_index] |= (1 << bit_index);
+    if(word_index < bitmap_words) {
+        bitmap[word_index] |= (1U << bit_index);
     }
 }
 
 void clear_bitmap(uint32_t bit)
 {
-    uint32_t byte_index = bit  / BITS_PER_BYTE;
-    uint32_t bit_index = bit % BITS_PER_BYTE;
+    uint32_t word_index = bit / BITS_PER_WORD;
+    uint32_t bit_index = bit % BITS_PER_WORD;
 
-    if(byte_index < BITMAP_SIZE) {
-        bitmap[byte_index] &= ~(1 << bit_index);
+    if(word_index < bitmap_words) {
+        bitmap[word_index] &= ~(1U << bit_index);
     }    
 }
 
 uint32_t test_bitmap(uint32_t bit)
 {
-    uint32_t byte_index = bit  / BITS_PER_BYTE;
-    uint32_t bit_index = bit % BITS_PER_BYTE;
+    uint32_t word_index = bit / BITS_PER_WORD;
+    uint32_t bit_index = bit % BITS_PER_WORD;
 
-    if(byte_index < BITMAP_SIZE) {
-        return (bitmap[byte_index] >> bit_index) & 1;
+    if(word_index < bitmap_words) {
+        return (bitmap[word_index] >> bit_index) & 1;
     }
 
     return 0;
-}
+}
\ No newline at end of file
@@ -7,39 +7,84 @@
 
 #define KERNEL_LOAD_ADDR  (0x10000)
 #define USABLE_MEM_START    (0x100000)
-#define KERNEL_HEAP_START   (0x100000)
-#define KERNEL_HEAP_SIZE    (0x100000)
 
+/* 引导程序保存的 E820 内存布局（见 boot.asm）；宿主机基准程序会改到自己映射的地址 */
+#ifndef MEMORY_MAP_COUNT_ADDR
+#define MEMORY_MAP_COUNT_ADDR   (0x4FF0)
+#define MEMORY_MAP_ADDR         (0x5000)
+#endif
+#define MEMORY_MAP_MAX          32
+
+/* 只管理恒等映射范围内的物理内存，更高的虚拟地址留给内核堆 */
+#define MEMORY_LIMIT        (0xE0000000ULL)
+
+#define E820_USABLE         1
+#define E820_RESERVED       2
+#define E820_ACPI_RECLAIM   3
+#define E820_ACPI_NVS       4
+#define E820_BAD            5
+
+/* BIOS 不提供 E820 时回退使用的内存大小 */
 #ifndef KERNEL_MEMORY_MB
 #define KERNEL_MEMORY_MB 64
 #endif
 
-#define TOTAL_MEMORY (KERNEL_MEMORY_MB * 1024 * 1024)
-#define USABLE_MEMORY (TOTAL_MEMORY - 0x100000)
+/* 物理内存分区：ISA DMA（软驱、声卡）只能访问 16MB 以下，普通分配优先使用其上的内存 */
+#define ZONE_DMA_LIMIT      (0x1000000)
+#define ZONE_DMA            0
+#define ZONE_NORMAL         1
+#define ZONE_COUNT          2
+
+/* 普通分配回退到 DMA 区时，始终给设备留下的帧数 */
+#define ZONE_DMA_RESERVE    64
+
+/* alloc_frame_zone 的分配标志 */
+#define ALLOC_NORMAL        0x0
+#define ALLOC_DMA           0x1     // 必须位于 ZONE_DMA_LIMIT 以下，不回退
+#define ALLOC_NORECLAIM     0x2     // 失败时直接返回，不触发直接回收
+
+/* 预清零帧池：空闲循环中补充，allocate_zeroed_frame 优先从池中取 */
+#define ZERO_POOL_SIZE      64
+#define ZERO_POOL_BATCH     8       // 每次空闲循环最多清零的帧数，缩短单次空闲工作
+
+#define CPUID_FEAT_EDX_SSE2 (1U << 26)  // movnti 非临时存储
 
 #define BITS_PER_BYTE 8
-#define BITMAP_SIZE ((USABLE_MEMORY / PAGE_SIZE) / BITS_PER_BYTE + 1)
+#define BITS_PER_WORD 32
+#define BITMAP_FULL_WORD 0xFFFFFFFF
 
 struct memory_region
 {
-    uint32_t base_addr;
-    uint32_t length;
+    uint64_t base_addr;
+    uint64_t length;
     uint32_t type;
-};
+    uint32_t acpi_attr;
+} __attribute__((packed));
 
 
 void memory_init(void);
 uint32_t get_total_memory(void);
 uint32_t get_usable_memory(void);
 uint32_t get_kernel_memory_mb(void);
+uint32_t get_free_frames(void);
+uint32_t get_zone_free_frames(uint32_t zone);
 
 void init_bitmap_allocator(void);
 uint32_t allocate_frame(void);
+uint32_t alloc_frame_zone(uint32_t flags);
+uint32_t allocate_zeroed_frame(void);
+void refill_zero_pool(void);
 void free_frame(uint32_t frame_index);
+uint32_t allocate_frames_bulk(uint32_t count, uint32_t* frames);
+void free_frames_bulk(uint32_t count, const uint32_t* frames);
+uint32_t allocate_frame_range(uint32_t count, uint32_t align);
+uint32_t alloc_frame_range_zone(uint32_t count, uint32_t align, uint32_t flags);
+void free_frame_range(uint32_t addr, uint32_t count);
 void set_bitmap(uint32_t bit);
 void clear_bitmap(uint32_t bit);
 uint32_t test_bitmap(uint32_t bit);
 void print_bitmap_stats(void);
+void benchmark_frame_allocator(void);
 
 void init_kernel_heap(void);
 
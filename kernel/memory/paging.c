@@ -0,0 +1,412 @@
+#include "paging.h"
+#include "memory.h"
+#include "stdio.h"
+#include "cpu.h"
+
+static uint32_t page_directory[PAGE_ENTRIES] __attribute__((aligned(PAGE_SIZE)));
+
+static bool has_pse = false;
+static bool has_pge = false;
+static bool enabled = false;
+static uint32_t kernel_flags = PAGE_PRESENT | PAGE_WRITE;
+
+static uint32_t large_pages = 0;
+static uint32_t page_tables = 0;
+static uint32_t split_count = 0;
+
+/* 按需清零区域：首次访问时才分配物理帧 */
+struct demand_region
+{
+    uint32_t start;
+    uint32_t end;
+};
+
+static struct demand_region demand_regions[DEMAND_REGIONS_MAX];
+static uint32_t demand_region_count = 0;
+static uint32_t zero_page = 0;
+static struct page_fault_stats fault_stats;
+
+static inline uint32_t* get_page_table(uint32_t pde)
+{
+    return (uint32_t*)(pde & PAGE_ADDR_MASK);
+}
+
+/* 分配一张清零的页表；物理内存是恒等映射的，可以直接访问 */
+static uint32_t* alloc_page_table(void)
+{
+    uint32_t frame = allocate_zeroed_frame();
+    if(!frame) {
+        printf("PAGING ERROR: Out of memory for page table\n");
+        return NULL;
+    }
+
+    page_tables++;
+    return (uint32_t*)frame;
+}
+
+/* 把 4MB 大页拆成一张页表，映射保持不变 */
+static int split_large_page(uint32_t dir_index)
+{
+    uint32_t pde = page_directory[dir_index];
+    uint32_t* table = alloc_page_table();
+    if(!table) return 0;
+
+    uint32_t base = pde & LARGE_PAGE_MASK;
+    uint32_t flags = pde & (PAGE_FLAGS_MASK & ~PAGE_LARGE);
+
+    for(uint32_t i = 0; i < PAGE_ENTRIES; i++) {
+        table[i] = (base + i * PAGE_SIZE) | flags;
+    }
+
+    page_directory[dir_index] = (uint32_t)table | PAGE_PRESENT | PAGE_WRITE | (pde & PAGE_USER);
+    large_pages--;
+    split_count++;
+
+    // 大页的 TLB 项可以用其范围内任一地址失效
+    invlpg(dir_index << 22);
+    return 1;
+}
+
+/* 取得 virt 对应的页表，必要时创建页表或拆分大页 */
+static uint32_t* walk_page_table(uint32_t virt, uint32_t flags)
+{
+    uint32_t dir_index = PAGE_DIR_INDEX(virt);
+    uint32_t pde = page_directory[dir_index];
+
+    if(!(pde & PAGE_PRESENT)) {
+        uint32_t* table = alloc_page_table();
+        if(!table) return NULL;
+
+        page_directory[dir_index] = (uint32_t)table | PAGE_PRESENT | PAGE_WRITE | (flags & PAGE_USER);
+        return table;
+    }
+
+    if(pde & PAGE_LARGE) {
+        if(!split_large_page(dir_index)) return NULL;
+        pde = page_directory[dir_index];
+    }
+
+    return get_page_table(pde);
+}
+
+int map_page(uint32_t virt, uint32_t phys, uint32_t flags)
+{
+    uint32_t* table = walk_page_table(virt, flags);
+    if(!table) return 0;
+
+    table[PAGE_TABLE_INDEX(virt)] = (phys & PAGE_ADDR_MASK) | (flags & PAGE_FLAGS_MASK) | PAGE_PRESENT;
+    if(enabled) invlpg(virt);
+
+    return 1;
+}
+
+void unmap_page(uint32_t virt)
+{
+    uint32_t pde = page_directory[PAGE_DIR_INDEX(virt)];
+    if(!(pde & PAGE_PRESENT)) return;
+
+    uint32_t* table = walk_page_table(virt, 0);
+    if(!table) return;
+
+    table[PAGE_TABLE_INDEX(virt)] = 0;
+    if(enabled) invlpg(virt);
+}
+
+/* 用一个 4MB 大页映射 virt，原有页表（如果有）被释放 */
+int map_large_page(uint32_t virt, uint32_t phys, uint32_t flags)
+{
+    if(!has_pse || (virt | phys) & ~LARGE_PAGE_MASK) {
+        return 0;
+    }
+
+    uint32_t dir_index = PAGE_DIR_INDEX(virt);
+    uint32_t pde = page_directory[dir_index];
+
+    page_directory[dir_index] = phys | (flags & PAGE_FLAGS_MASK) | PAGE_PRESENT | PAGE_LARGE;
+    large_pages++;
+
+    if((pde & PAGE_PRESENT) && !(pde & PAGE_LARGE)) {
+        free_frame(pde & PAGE_ADDR_MASK);
+        page_tables--;
+        if(enabled) tlb_shootdown(virt, PAGE_ENTRIES);
+    }
+    else if(pde & PAGE_LARGE) {
+        large_pages--;
+        if(enabled) invlpg(virt);
+    }
+
+    return 1;
+}
+
+uint32_t get_physical_address(uint32_t virt)
+{
+    uint32_t pde = page_directory[PAGE_DIR_INDEX(virt)];
+    if(!(pde & PAGE_PRESENT)) return 0;
+
+    if(pde & PAGE_LARGE) {
+        return (pde & LARGE_PAGE_MASK) | (virt & ~LARGE_PAGE_MASK);
+    }
+
+    uint32_t pte = get_page_table(pde)[PAGE_TABLE_INDEX(virt)];
+    if(!(pte & PAGE_PRESENT)) return 0;
+
+    return (pte & PAGE_ADDR_MASK) | (virt & PAGE_FLAGS_MASK);
+}
+
+void flush_tlb_all(void)
+{
+    if(has_pge) {
+        // 切换 CR4.PGE 才能连同全局页一起刷新
+        uint32_t cr4 = read_cr4();
+        write_cr4(cr4 & ~CR4_PGE);
+        write_cr4(cr4);
+    }
+    else {
+        write_cr3(read_cr3());
+    }
+}
+
+/* 使 [virt, virt + pages * PAGE_SIZE) 的 TLB 项失效（单 CPU，只处理本地 TLB） */
+void tlb_shootdown(uint32_t virt, uint32_t pages)
+{
+    if(pages > TLB_FLUSH_THRESHOLD) {
+        flush_tlb_all();
+        return;
+    }
+
+    for(uint32_t i = 0; i < pages; i++) {
+        invlpg(virt + i * PAGE_SIZE);
+    }
+}
+
+bool paging_enabled(void)
+{
+    return enabled;
+}
+
+void paging_init(void)
+{
+    printf("Initializing paging...\n");
+
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    has_pse = (edx & CPUID_FEAT_EDX_PSE) != 0;
+    has_pge = (edx & CPUID_FEAT_EDX_PGE) != 0;
+
+    if(has_pge) kernel_flags |= PAGE_GLOBAL;
+
+    memset(page_directory, 0, sizeof(page_directory));
+
+    // 恒等映射全部物理内存：有 PSE 时用 4MB 全局大页，否则退回 4KB 页表
+    uint32_t top = (get_total_memory() + LARGE_PAGE_SIZE - 1) & LARGE_PAGE_MASK;
+    for(uint32_t addr = 0; addr < top; addr += LARGE_PAGE_SIZE)
+    {
+        if(has_pse) {
+            map_large_page(addr, addr, kernel_flags);
+            continue;
+        }
+
+        for(uint32_t page = addr; page < addr + LARGE_PAGE_SIZE; page += PAGE_SIZE) {
+            if(!map_page(page, page, kernel_flags)) return;
+        }
+    }
+
+    register_interrupt_handler(14, page_fault_handler, NULL);
+
+    uint32_t cr4 = read_cr4();
+    if(has_pse) cr4 |= CR4_PSE;
+    write_cr4(cr4);
+
+    write_cr3((uint32_t)page_directory);
+    write_cr0(read_cr0() | CR0_PG | CR0_WP);
+
+    // 分页开启后再置 PGE，避免全局位在未分页时生效
+    if(has_pge) write_cr4(read_cr4() | CR4_PGE);
+
+    enabled = true;
+
+    // 所有读缺页共享这一个只读的全零帧
+    zero_page = allocate_zeroed_frame();
+
+    printf("Paging enabled: %d MB identity mapped (PSE: %s, PGE: %s)\n",
+           top / (1024 * 1024), has_pse ? "yes" : "no", has_pge ? "yes" : "no");
+}
+
+void paging_stats(void)
+{
+    printf("\n=== Paging Statistics ===\n");
+    printf("Page directory: 0x%x\n", (uint32_t)page_directory);
+    printf("4MB pages:      %d\n", large_pages);
+    printf("Page tables:    %d\n", page_tables);
+    printf("Large splits:   %d\n", split_count);
+}
+
+#define BENCH_PASSES        16
+#define BENCH_REGION_START  USABLE_MEM_START
+#define BENCH_REGION_SIZE   0x100000
+
+/* 每轮先刷新 TLB，再按页步长遍历测试区域，比较 4KB 页与 4MB 大页的开销 */
+static uint32_t walk_bench_region(void)
+{
+    uint64_t cycles = 0;
+
+    for(int pass = 0; pass < BENCH_PASSES; pass++)
+    {
+        flush_tlb_all();
+
+        uint64_t start = rdtsc();
+        for(uint32_t addr = BENCH_REGION_START; addr < BENCH_REGION_START + BENCH_REGION_SIZE; addr += PAGE_SIZE) {
+            (void)*(volatile uint32_t*)addr;
+        }
+        cycles += rdtsc() - start;
+    }
+
+    return (uint32_t)div_u64(cycles, BENCH_PASSES);
+}
+
+void benchmark_paging(void)
+{
+    uint32_t dir_index = PAGE_DIR_INDEX(BENCH_REGION_START);
+
+    if(!enabled || !(page_directory[dir_index] & PAGE_LARGE)) {
+        printf("Paging benchmark skipped: region is not on a 4MB page\n");
+        return;
+    }
+
+    uint32_t pages = BENCH_REGION_SIZE / PAGE_SIZE;
+
+    uint32_t large_cycles = walk_bench_region();
+
+    // 拆分失败时区域仍是大页，两次测量没有可比性
+    if(!split_large_page(dir_index)) {
+        printf("Paging benchmark skipped: cannot split the 4MB page\n");
+        return;
+    }
+    uint32_t small_cycles = walk_bench_region();
+
+    map_large_page(dir_index << 22, dir_index << 22, kernel_flags);
+
+    printf("Paging benchmark (%d pages, %d passes, TLB flushed per pass):\n", pages, BENCH_PASSES);
+    printf("  4KB pages: avg %d cycles/pass (%d per page)\n", small_cycles, small_cycles / pages);
+    printf("  4MB pages: avg %d cycles/pass (%d per page)\n", large_cycles, large_cycles / pages);
+}
+
+/* 登记一段按需清零的虚拟地址区域，区域内不预先映射任何页 */
+int reserve_demand_region(uint32_t start, uint32_t size)
+{
+    if(demand_region_count >= DEMAND_REGIONS_MAX || !zero_page) {
+        return 0;
+    }
+
+    demand_regions[demand_region_count].start = start & PAGE_ADDR_MASK;
+    demand_regions[demand_region_count].end = start + size;
+    demand_region_count++;
+
+    return 1;
+}
+
+/* 撤销按需区域 [start, start + size) 中已建立的映射，私有帧归还帧分配器 */
+void release_demand_pages(uint32_t start, uint32_t size)
+{
+    uint32_t end = start + size;
+    uint32_t released = 0;
+
+    for(uint32_t page = start & PAGE_ADDR_MASK; page < end; page += PAGE_SIZE)
+    {
+        uint32_t pde = page_directory[PAGE_DIR_INDEX(page)];
+        if(!(pde & PAGE_PRESENT) || (pde & PAGE_LARGE)) {
+            // 整个目录项没有页表，跳到下一个 4MB 边界
+            page = (page & LARGE_PAGE_MASK) + LARGE_PAGE_SIZE - PAGE_SIZE;
+            continue;
+        }
+
+        uint32_t* table = get_page_table(pde);
+        uint32_t pte = table[PAGE_TABLE_INDEX(page)];
+        if(!(pte & PAGE_PRESENT)) continue;
+
+        table[PAGE_TABLE_INDEX(page)] = 0;
+        released++;
+
+        if((pte & PAGE_ADDR_MASK) != zero_page) {
+            free_frame(pte & PAGE_ADDR_MASK);
+            fault_stats.resident_pages--;
+        }
+    }
+
+    if(enabled && released) tlb_shootdown(start, size / PAGE_SIZE);
+}
+
+void get_page_fault_stats(struct page_fault_stats* stats)
+{
+    *stats = fault_stats;
+}
+
+static bool in_demand_region(uint32_t addr)
+{
+    for(uint32_t i = 0; i < demand_region_count; i++) {
+        if(addr >= demand_regions[i].start && addr < demand_regions[i].end) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* 为 page 分配一个清零的私有帧并以可写方式映射 */
+static int map_private_zeroed(uint32_t page)
+{
+    uint32_t frame = allocate_zeroed_frame();
+    if(!frame) return 0;
+
+    if(!map_page(page, frame, PAGE_PRESENT | PAGE_WRITE)) {
+        free_frame(frame);
+        return 0;
+    }
+
+    fault_stats.resident_pages++;
+    return 1;
+}
+
+/* 缺页异常处理：按需区域内读缺页映射共享零页，写缺页分配私有帧 */
+void page_fault_handler(struct interrupt_frame* frame, void* ctx)
+{
+    (void)ctx;
+    uint32_t addr = read_cr2();
+    uint32_t page = addr & PAGE_ADDR_MASK;
+    uint32_t err = frame->err_code;
+
+    fault_stats.total++;
+
+    if(in_demand_region(addr) && !(err & PF_RESERVED))
+    {
+        if(!(err & PF_PRESENT)) {
+            if(!(err & PF_WRITE)) {
+                if(map_page(page, zero_page, PAGE_PRESENT)) {
+                    fault_stats.zero_maps++;
+                    return;
+                }
+            }
+            else if(map_private_zeroed(page)) {
+                fault_stats.demand_allocs++;
+                return;
+            }
+        }
+        else if((err & PF_WRITE) && get_physical_address(page) == zero_page) {
+            if(map_private_zeroed(page)) {
+                fault_stats.zero_breaks++;
+                return;
+            }
+        }
+    }
+
+    printf("\n=== PAGE FAULT ===\n");
+    printf("Faulting Address: 0x%x\n", addr);
+    printf("Faulting Instruction: 0x%x\n", frame->eip);
+    printf("Error Code: 0x%x (%s, %s, %s)\n", err,
+           (err & PF_PRESENT) ? "protection" : "not present",
+           (err & PF_WRITE) ? "write" : "read",
+           (err & PF_USER) ? "user" : "kernel");
+    printf("System Halted\n");
+
+    local_irq_disable();
+    while(1) asm volatile("hlt");
+}
@@ -0,0 +1,75 @@
+#ifndef PAGING_H
+#define PAGING_H
+
+#include "types.h"
+#include "interrupt.h"
+
+/* 页目录项/页表项标志位 */
+#define PAGE_PRESENT    0x001
+#define PAGE_WRITE      0x002
+#define PAGE_USER       0x004
+#define PAGE_PWT        0x008
+#define PAGE_PCD        0x010
+#define PAGE_ACCESSED   0x020
+#define PAGE_DIRTY      0x040
+#define PAGE_LARGE      0x080   // 仅页目录项：4MB 大页 (PSE)
+#define PAGE_GLOBAL     0x100
+
+#define PAGE_FLAGS_MASK 0xFFF
+#define PAGE_ADDR_MASK  0xFFFFF000
+
+#define PAGE_ENTRIES        1024
+#define LARGE_PAGE_SIZE     0x400000
+#define LARGE_PAGE_MASK     0xFFC00000
+
+#define PAGE_DIR_INDEX(addr)    ((addr) >> 22)
+#define PAGE_TABLE_INDEX(addr)  (((addr) >> 12) & 0x3FF)
+
+/* 超过此页数时整体刷新 TLB，而不是逐页 invlpg */
+#define TLB_FLUSH_THRESHOLD 32
+
+/* 缺页错误码 */
+#define PF_PRESENT  0x01    // 0: 页不存在, 1: 保护违例
+#define PF_WRITE    0x02
+#define PF_USER     0x04
+#define PF_RESERVED 0x08
+#define PF_FETCH    0x10
+
+/* 按需清零映射的区域数上限 */
+#define DEMAND_REGIONS_MAX  4
+
+#define CR0_WP      (1U << 16)
+#define CR0_PG      (1U << 31)
+#define CR4_PSE     (1U << 4)
+#define CR4_PGE     (1U << 7)
+
+#define CPUID_FEAT_EDX_PSE  (1U << 3)
+#define CPUID_FEAT_EDX_PGE  (1U << 13)
+
+void paging_init(void);
+bool paging_enabled(void);
+int map_page(uint32_t virt, uint32_t phys, uint32_t flags);
+void unmap_page(uint32_t virt);
+int map_large_page(uint32_t virt, uint32_t phys, uint32_t flags);
+uint32_t get_physical_address(uint32_t virt);
+void tlb_shootdown(uint32_t virt, uint32_t pages);
+void flush_tlb_all(void);
+void paging_stats(void);
+
+/* 缺页统计 */
+struct page_fault_stats
+{
+    uint32_t total;             // 缺页总数
+    uint32_t zero_maps;         // 读缺页：映射共享零页
+    uint32_t demand_allocs;     // 写缺页：分配并清零新帧
+    uint32_t zero_breaks;       // 写共享零页：替换为私有帧
+    uint32_t resident_pages;    // 按需区域中当前驻留的私有帧
+};
+
+int reserve_demand_region(uint32_t start, uint32_t size);
+void release_demand_pages(uint32_t start, uint32_t size);
+void get_page_fault_stats(struct page_fault_stats* stats);
+void page_fault_handler(struct interrupt_frame* frame, void* ctx);
+void benchmark_paging(void);
+
+#endif
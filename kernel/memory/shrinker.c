@@ -0,0 +1,109 @@
+#include "shrinker.h"
+#include "memory.h"
+#include "stdio.h"
+
+static struct shrinker* shrinker_list = NULL;
+static bool reclaiming = false;
+
+static uint32_t direct_runs = 0;
+static uint32_t direct_pages = 0;
+static uint32_t background_runs = 0;
+static uint32_t background_pages = 0;
+
+/* 注册 shrinker，重复注册返回 0 */
+int register_shrinker(struct shrinker* shrinker)
+{
+    for(struct shrinker* s = shrinker_list; s; s = s->next) {
+        if(s == shrinker) return 0;
+    }
+
+    shrinker->scans = 0;
+    shrinker->reclaimed = 0;
+    shrinker->next = shrinker_list;
+    shrinker_list = shrinker;
+
+    return 1;
+}
+
+void unregister_shrinker(struct shrinker* shrinker)
+{
+    struct shrinker** link = &shrinker_list;
+    while(*link && *link != shrinker) {
+        link = &(*link)->next;
+    }
+    if(*link) *link = shrinker->next;
+}
+
+/* 依次让各 shrinker 交出内存，直到回收 pages 页或一整轮没有进展；
+ * 回收过程中再次分配失败不会递归回收 */
+uint32_t shrink_memory(uint32_t pages, uint32_t flags)
+{
+    if(reclaiming || 0 == pages) return 0;
+    reclaiming = true;
+
+    uint32_t total = 0;
+    for(uint32_t pass = 0; pass < SHRINK_MAX_PASSES && total < pages; pass++)
+    {
+        uint32_t progress = 0;
+
+        for(struct shrinker* s = shrinker_list; s && total < pages; s = s->next)
+        {
+            if(0 == s->count(s->ctx)) continue;
+
+            uint32_t got = s->scan(s->ctx, pages - total, flags);
+            s->scans++;
+            s->reclaimed += got;
+            progress += got;
+            total += got;
+        }
+
+        if(0 == progress) break;
+    }
+
+    if(flags & SHRINK_DIRECT) {
+        direct_runs++;
+        direct_pages += total;
+    }
+    else {
+        background_runs++;
+        background_pages += total;
+    }
+
+    reclaiming = false;
+    return total;
+}
+
+static uint32_t watermark_low(void)
+{
+    uint32_t low = get_usable_memory() / PAGE_SIZE / SHRINK_WATERMARK_DIV;
+    return low < SHRINK_WATERMARK_MIN ? SHRINK_WATERMARK_MIN : low;
+}
+
+/* 空闲帧低于高水位，不宜再把内存囤进缓存 */
+bool memory_low(void)
+{
+    return get_free_frames() < 2 * watermark_low();
+}
+
+/* 空闲循环中调用：空闲帧低于低水位时回收到高水位（低水位的两倍） */
+void reclaim_background(void)
+{
+    uint32_t low = watermark_low();
+    uint32_t free = get_free_frames();
+
+    if(free < low) {
+        shrink_memory(2 * low - free, 0);
+    }
+}
+
+void shrinker_stats(void)
+{
+    printf("\n=== Shrinkers (low watermark %d frames) ===\n", watermark_low());
+    printf("Direct reclaim: %d runs, %d pages\n", direct_runs, direct_pages);
+    printf("Background reclaim: %d runs, %d pages\n", background_runs, background_pages);
+
+    for(struct shrinker* s = shrinker_list; s; s = s->next) {
+        printf("  %-12s reclaimable %d pages, %d scans, %d reclaimed\n",
+               s->name, s->count(s->ctx), s->scans, s->reclaimed);
+    }
+}
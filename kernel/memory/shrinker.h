@@ -0,0 +1,35 @@
+#ifndef SHRINKER_H
+#define SHRINKER_H
+
+#include "types.h"
+
+/* 空闲帧水位：低于低水位时空闲循环开始后台回收，直到回到高水位 */
+#define SHRINK_WATERMARK_DIV    64      // 低水位 = 可用帧的 1/64
+#define SHRINK_WATERMARK_MIN    16      // 低水位下限（帧）
+#define SHRINK_MAX_PASSES       4       // 一次回收最多轮询所有 shrinker 的次数
+
+/* 回收标志 */
+#define SHRINK_DIRECT           0x1     // 分配路径中的同步回收，调用者可能处于其他子系统的中间状态
+
+/* 持有可回收内存的子系统注册的回调，结构体由注册者提供 */
+struct shrinker
+{
+    const char* name;
+    uint32_t (*count)(void* ctx);                                   // 估计可回收的页数
+    uint32_t (*scan)(void* ctx, uint32_t pages, uint32_t flags);    // 尝试回收 pages 页，返回实际回收数
+    void* ctx;
+
+    uint32_t scans;
+    uint32_t reclaimed;
+
+    struct shrinker* next;
+};
+
+int register_shrinker(struct shrinker* shrinker);
+void unregister_shrinker(struct shrinker* shrinker);
+uint32_t shrink_memory(uint32_t pages, uint32_t flags);
+void reclaim_background(void);
+bool memory_low(void);
+void shrinker_stats(void);
+
+#endif
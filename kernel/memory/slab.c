@@ -0,0 +1,298 @@
+#include "slab.h"
+#include "heap.h"
+#include "memory.h"
+#include "buddy.h"
+#include "shrinker.h"
+#include "stdio.h"
+
+static struct kmem_cache* cache_list = NULL;
+static struct shrinker slab_shrinker;
+
+static inline uint32_t align_up(uint32_t value, uint32_t align)
+{
+    return (value + align - 1) & ~(align - 1);
+}
+
+static inline void** free_pointer(struct kmem_cache* cache, void* obj)
+{
+    return (void**)((uint8_t*)obj + cache->free_offset);
+}
+
+static inline uint32_t slab_bytes(struct kmem_cache* cache)
+{
+    return PAGE_SIZE << cache->order;
+}
+
+static void list_add(struct slab** head, struct slab* slab)
+{
+    slab->prev = NULL;
+    slab->next = *head;
+    if(*head) (*head)->prev = slab;
+    *head = slab;
+}
+
+static void list_del(struct slab** head, struct slab* slab)
+{
+    if(slab->prev) slab->prev->next = slab->next;
+    else *head = slab->next;
+
+    if(slab->next) slab->next->prev = slab->prev;
+}
+
+/* 单页 slab 走位图分配器，多页 slab 走伙伴分配器（块按自身大小对齐） */
+static uint32_t alloc_slab_pages(uint32_t order)
+{
+    return order ? alloc_pages(order) : allocate_frame();
+}
+
+static void free_slab_pages(uint32_t addr, uint32_t order)
+{
+    if(order) free_pages(addr, order);
+    else free_frame(addr);
+}
+
+/* 每个 slab 的浪费：描述符与对齐填充 + 尾部放不下一个对象的剩余 */
+static uint32_t slab_waste(struct kmem_cache* cache)
+{
+    return slab_bytes(cache) - cache->objects_per_slab * cache->object_size;
+}
+
+struct kmem_cache* kmem_cache_create(const char* name, uint32_t size, uint32_t align,
+                                     void (*ctor)(void*))
+{
+    if(0 == size) return NULL;
+
+    if(align < HEAP_ALIGNMENT) align = HEAP_ALIGNMENT;
+    if(align & (align - 1)) {
+        printf("SLAB ERROR: Alignment %d of cache %s is not a power of two\n", align, name);
+        return NULL;
+    }
+
+    // 有构造函数时，空闲链表指针放在对象末尾之后，不破坏已构造的内容
+    uint32_t free_offset = ctor ? align_up(size, sizeof(void*)) : 0;
+    uint32_t object_size = align_up(free_offset + sizeof(void*) > size ?
+                                    free_offset + sizeof(void*) : size, align);
+    uint32_t first_offset = align_up(sizeof(struct slab), align);
+
+    // 选择最小的 slab 阶数，使浪费不超过 slab 的 1/8
+    uint32_t order = 0;
+    while(order < KMEM_MAX_ORDER) {
+        uint32_t bytes = PAGE_SIZE << order;
+        if(first_offset + object_size <= bytes &&
+           (bytes - first_offset) % object_size <= bytes / 8) {
+            break;
+        }
+        order++;
+    }
+
+    if(first_offset + object_size > (uint32_t)(PAGE_SIZE << order)) {
+        printf("SLAB ERROR: Object size %d too large for cache %s\n", size, name);
+        return NULL;
+    }
+
+    struct kmem_cache* cache = (struct kmem_cache*)kmalloc(sizeof(struct kmem_cache));
+    if(!cache) return NULL;
+
+    memset(cache, 0, sizeof(struct kmem_cache));
+
+    uint32_t i = 0;
+    for(; name[i] && i < KMEM_NAME_LEN - 1; i++) {
+        cache->name[i] = name[i];
+    }
+    cache->name[i] = '\0';
+
+    cache->size = size;
+    cache->object_size = object_size;
+    cache->align = align;
+    cache->order = order;
+    cache->first_offset = first_offset;
+    cache->free_offset = free_offset;
+    cache->objects_per_slab = ((PAGE_SIZE << order) - first_offset) / object_size;
+    cache->ctor = ctor;
+
+    if(!cache_list) register_shrinker(&slab_shrinker);
+    cache->next = cache_list;
+    cache_list = cache;
+
+    return cache;
+}
+
+static struct slab* slab_create(struct kmem_cache* cache)
+{
+    uint32_t addr = alloc_slab_pages(cache->order);
+    if(!addr) return NULL;
+
+    struct slab* slab = (struct slab*)addr;
+    slab->cache = cache;
+    slab->inuse = 0;
+    slab->free_list = NULL;
+
+    // 倒序串起空闲链表，使分配按地址递增
+    for(uint32_t i = cache->objects_per_slab; i > 0; i--) {
+        void* obj = (void*)(addr + cache->first_offset + (i - 1) * cache->object_size);
+        if(cache->ctor) cache->ctor(obj);
+
+        *free_pointer(cache, obj) = slab->free_list;
+        slab->free_list = obj;
+    }
+
+    cache->slab_count++;
+    return slab;
+}
+
+static void slab_release(struct kmem_cache* cache, struct slab* slab)
+{
+    cache->slab_count--;
+    free_slab_pages((uint32_t)slab, cache->order);
+}
+
+void* kmem_cache_alloc(struct kmem_cache* cache)
+{
+    struct slab* slab = cache->partial;
+
+    if(!slab) {
+        slab = cache->empty;
+        if(slab) {
+            list_del(&cache->empty, slab);
+            cache->empty_count--;
+        }
+        else {
+            slab = slab_create(cache);
+            if(!slab) {
+                printf("SLAB ERROR: Out of memory in cache %s\n", cache->name);
+                return NULL;
+            }
+        }
+        list_add(&cache->partial, slab);
+    }
+
+    void* obj = slab->free_list;
+    slab->free_list = *free_pointer(cache, obj);
+    slab->inuse++;
+    cache->active_objects++;
+
+    if(slab->inuse == cache->objects_per_slab) {
+        list_del(&cache->partial, slab);
+        list_add(&cache->full, slab);
+    }
+
+    return obj;
+}
+
+void kmem_cache_free(struct kmem_cache* cache, void* obj)
+{
+    if(!obj) return;
+
+    struct slab* slab = (struct slab*)((uint32_t)obj & ~(slab_bytes(cache) - 1));
+    if(slab->cache != cache) {
+        printf("SLAB ERROR: Object 0x%x does not belong to cache %s\n", obj, cache->name);
+        return;
+    }
+
+    if(slab->inuse == cache->objects_per_slab) {
+        list_del(&cache->full, slab);
+        list_add(&cache->partial, slab);
+    }
+
+    *free_pointer(cache, obj) = slab->free_list;
+    slab->free_list = obj;
+    slab->inuse--;
+    cache->active_objects--;
+
+    if(0 == slab->inuse) {
+        list_del(&cache->partial, slab);
+
+        if(cache->empty_count < KMEM_MAX_EMPTY) {
+            list_add(&cache->empty, slab);
+            cache->empty_count++;
+        }
+        else {
+            slab_release(cache, slab);
+        }
+    }
+}
+
+/* 释放缓存中所有空 slab，返回归还的页数 */
+uint32_t kmem_cache_shrink(struct kmem_cache* cache)
+{
+    uint32_t pages = 0;
+
+    while(cache->empty) {
+        struct slab* slab = cache->empty;
+        list_del(&cache->empty, slab);
+        slab_release(cache, slab);
+        pages += 1U << cache->order;
+    }
+    cache->empty_count = 0;
+
+    return pages;
+}
+
+/* 内存紧张时交还各缓存保留的空 slab */
+static uint32_t slab_shrink_count(void* ctx)
+{
+    (void)ctx;
+    uint32_t pages = 0;
+
+    for(struct kmem_cache* cache = cache_list; cache; cache = cache->next) {
+        pages += cache->empty_count << cache->order;
+    }
+    return pages;
+}
+
+static uint32_t slab_shrink_scan(void* ctx, uint32_t pages, uint32_t flags)
+{
+    (void)ctx;
+    (void)flags;
+    uint32_t freed = 0;
+
+    for(struct kmem_cache* cache = cache_list; cache && freed < pages; cache = cache->next) {
+        freed += kmem_cache_shrink(cache);
+    }
+    return freed;
+}
+
+static struct shrinker slab_shrinker = {
+    "slab", slab_shrink_count, slab_shrink_scan, NULL, 0, 0, NULL
+};
+
+void kmem_cache_destroy(struct kmem_cache* cache)
+{
+    if(cache->active_objects) {
+        printf("SLAB WARNING: Destroying cache %s with %d live objects\n",
+               cache->name, cache->active_objects);
+    }
+
+    struct slab** lists[] = {&cache->full, &cache->partial, &cache->empty};
+    for(uint32_t i = 0; i < 3; i++) {
+        while(*lists[i]) {
+            struct slab* slab = *lists[i];
+            list_del(lists[i], slab);
+            slab_release(cache, slab);
+        }
+    }
+
+    struct kmem_cache** link = &cache_list;
+    while(*link && *link != cache) {
+        link = &(*link)->next;
+    }
+    if(*link) *link = cache->next;
+
+    kfree(cache);
+}
+
+void kmem_cache_stats(void)
+{
+    printf("\n=== Slab Caches ===\n");
+    printf("%-16s %6s %8s %8s %6s %8s\n", "name", "objsz", "active", "total", "slabs", "waste");
+
+    for(struct kmem_cache* cache = cache_list; cache; cache = cache->next)
+    {
+        uint32_t total = cache->slab_count * cache->objects_per_slab;
+        uint32_t waste = cache->slab_count * slab_waste(cache) +
+                         total * (cache->object_size - cache->size);
+
+        printf("%-16s %6d %8d %8d %6d %8d\n", cache->name, cache->object_size,
+               cache->active_objects, total, cache->slab_count, waste);
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include "types.h"
+
+#define KMEM_NAME_LEN       16
+#define KMEM_MAX_ORDER      3       // 单个 slab 最多 8 页
+#define KMEM_MAX_EMPTY      1       // 每个缓存保留的空 slab 数，多余的归还帧分配器
+
+/* slab 描述符，放在 slab 首页的开头 */
+struct slab
+{
+    struct kmem_cache* cache;
+    struct slab* next;
+    struct slab* prev;
+    void* free_list;            // 空闲对象单链表，指针存放在对象内 free_offset 处
+    uint32_t inuse;
+};
+
+struct kmem_cache
+{
+    char name[KMEM_NAME_LEN];
+    uint32_t size;              // 请求的对象大小
+    uint32_t object_size;       // 对齐后的对象大小
+    uint32_t align;
+    uint32_t order;             // slab 大小 = 2^order 页
+    uint32_t objects_per_slab;
+    uint32_t first_offset;      // 第一个对象相对 slab 起始的偏移
+    uint32_t free_offset;       // 空闲链表指针在对象内的偏移
+    void (*ctor)(void*);
+
+    struct slab* full;
+    struct slab* partial;
+    struct slab* empty;
+
+    uint32_t slab_count;
+    uint32_t empty_count;
+    uint32_t active_objects;
+
+    struct kmem_cache* next;
+};
+
+struct kmem_cache* kmem_cache_create(const char* name, uint32_t size, uint32_t align,
+                                     void (*ctor)(void*));
+void kmem_cache_destroy(struct kmem_cache* cache);
+void* kmem_cache_alloc(struct kmem_cache* cache);
+void kmem_cache_free(struct kmem_cache* cache, void* obj);
+uint32_t kmem_cache_shrink(struct kmem_cache* cache);
+void kmem_cache_stats(void);
+
+#endif
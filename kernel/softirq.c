@@ -0,0 +1,150 @@
+#include "softirq.h"
+#include "apic.h"
+#include "stdio.h"
+#include "cpu.h"
+
+/* 单个队列及其统计，延迟以 TSC 周期计 */
+struct tasklet_queue
+{
+    const char* name;
+    struct tasklet* head;
+    struct tasklet* tail;
+
+    uint32_t depth;
+    uint32_t max_depth;
+    uint32_t scheduled;
+    uint32_t executed;
+    uint64_t total_latency;
+    uint64_t max_latency;
+};
+
+static struct tasklet_queue queues[TASKLET_QUEUES] = {
+    [TASKLET_HI]     = { .name = "hi" },
+    [TASKLET_NORMAL] = { .name = "normal" },
+};
+
+static bool running = false;
+static uint32_t irq_exit_runs = 0;
+
+/* 可在中断上下文调用；已在队列中返回 0 */
+static int enqueue(uint32_t index, struct tasklet* t)
+{
+    struct tasklet_queue* q = &queues[index];
+    uint32_t flags = irq_save();
+
+    if(t->queued) {
+        irq_restore(flags);
+        return 0;
+    }
+
+    t->queued = true;
+    t->enqueue_tsc = rdtsc();
+    t->next = NULL;
+    if(q->tail) q->tail->next = t;
+    else q->head = t;
+    q->tail = t;
+
+    q->scheduled++;
+    if(++q->depth > q->max_depth) q->max_depth = q->depth;
+
+    irq_restore(flags);
+    return 1;
+}
+
+int tasklet_schedule(struct tasklet* t)
+{
+    return enqueue(TASKLET_NORMAL, t);
+}
+
+int tasklet_hi_schedule(struct tasklet* t)
+{
+    return enqueue(TASKLET_HI, t);
+}
+
+bool softirq_pending(void)
+{
+    return queues[TASKLET_HI].head || queues[TASKLET_NORMAL].head;
+}
+
+/* 取出下一项，高优先级队列优先 */
+static struct tasklet* dequeue(struct tasklet_queue** from)
+{
+    uint32_t flags = irq_save();
+
+    for(uint32_t i = 0; i < TASKLET_QUEUES; i++) {
+        struct tasklet_queue* q = &queues[i];
+        struct tasklet* t = q->head;
+        if(!t) continue;
+
+        q->head = t->next;
+        if(!q->head) q->tail = NULL;
+        q->depth--;
+        t->queued = false;
+
+        irq_restore(flags);
+        *from = q;
+        return t;
+    }
+
+    irq_restore(flags);
+    return NULL;
+}
+
+/* 执行最多 budget 项，返回执行数；调用者的中断状态原样保留给工作项，
+ * 嵌套调用（执行中被中断）直接返回 */
+uint32_t run_deferred_work(uint32_t budget)
+{
+    if(running) return 0;
+    running = true;
+
+    uint32_t done = 0;
+    struct tasklet_queue* q;
+    struct tasklet* t;
+
+    while(done < budget && (t = dequeue(&q)))
+    {
+        uint64_t latency = rdtsc() - t->enqueue_tsc;
+        q->executed++;
+        q->total_latency += latency;
+        if(latency > q->max_latency) q->max_latency = latency;
+
+        t->fn(t->data);
+        done++;
+    }
+
+    running = false;
+    return done;
+}
+
+/* 硬件中断向量：重映射后的 IRQ 和 LAPIC 定时器（动态时钟下由它驱动 tick） */
+static inline bool hardware_vector(uint32_t vector)
+{
+    return (vector >= IRQ_BASE && vector < IRQ_BASE + IRQ_COUNT) || LAPIC_TIMER_VECTOR == vector;
+}
+
+/* isr_common 在处理函数返回后调用：硬件中断已应答，开中断执行下半部 */
+void irq_exit(struct interrupt_frame* frame)
+{
+    if(hardware_vector(frame->int_no) && !running && softirq_pending()) {
+        irq_exit_runs++;
+        local_irq_enable();
+        run_deferred_work(SOFTIRQ_BUDGET);
+        local_irq_disable();
+    }
+
+    TRACE_IRQ_EXIT(frame);
+}
+
+void softirq_stats(void)
+{
+    printf("\n=== Deferred Work (irq exit %d runs) ===\n", irq_exit_runs);
+
+    for(uint32_t i = 0; i < TASKLET_QUEUES; i++) {
+        struct tasklet_queue* q = &queues[i];
+        uint32_t avg = q->executed ? (uint32_t)div_u64(q->total_latency, q->executed) : 0;
+
+        printf("  %-6s depth %d (max %d), %d scheduled, %d run, latency avg %d / max %d cycles\n",
+               q->name, q->depth, q->max_depth, q->scheduled, q->executed,
+               avg, (uint32_t)q->max_latency);
+    }
+}
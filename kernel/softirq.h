@@ -0,0 +1,36 @@
+#ifndef SOFTIRQ_H
+#define SOFTIRQ_H
+
+#include "types.h"
+#include "interrupt.h"
+
+/* 下半部队列：中断处理函数只应答硬件并排队，实际工作在开中断的状态下
+ * 于中断返回前或空闲循环中执行 */
+#define TASKLET_HI          0       // 先于普通队列执行，留给对延迟敏感的工作
+#define TASKLET_NORMAL      1
+#define TASKLET_QUEUES      2
+
+#define SOFTIRQ_BUDGET      16      // 每次中断返回最多执行的项数，剩余的交给空闲循环
+
+/* 延迟执行的工作项，结构体由调度者提供；同一项在执行前重复调度只排队一次 */
+struct tasklet
+{
+    void (*fn)(void* data);
+    void* data;
+
+    bool queued;
+    uint64_t enqueue_tsc;
+
+    struct tasklet* next;
+};
+
+#define TASKLET_INIT(func, arg) { .fn = (func), .data = (arg) }
+
+int tasklet_schedule(struct tasklet* t);
+int tasklet_hi_schedule(struct tasklet* t);
+bool softirq_pending(void);
+uint32_t run_deferred_work(uint32_t budget);
+void irq_exit(struct interrupt_frame* frame);
+void softirq_stats(void);
+
+#endif
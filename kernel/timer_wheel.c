@@ -0,0 +1,210 @@
+#include "timer_wheel.h"
+#include "timer.h"
+#include "softirq.h"
+#include "stdio.h"
+#include "cpu.h"
+
+static struct timer* tv1[TVR_SIZE];
+static struct timer* tvn[TVN_LEVELS][TVN_SIZE];
+
+/* 下一个要处理的 tick；没有定时器时不推进，添加时再追上当前时间 */
+static uint32_t wheel_ticks = 0;
+
+static uint32_t pending = 0;
+static uint32_t max_pending = 0;
+static uint32_t added = 0;
+static uint32_t expired = 0;
+static uint32_t cascaded = 0;
+
+static void run_timers(void* data);
+static struct tasklet timer_tasklet = TASKLET_INIT(run_timers, NULL);
+
+#define TVN_INDEX(level, tick)  (((tick) >> (TVR_BITS + (level) * TVN_BITS)) & TVN_MASK)
+
+static void list_add(struct timer** head, struct timer* t)
+{
+    t->next = *head;
+    if(t->next) t->next->pprev = &t->next;
+    *head = t;
+    t->pprev = head;
+}
+
+static void list_del(struct timer* t)
+{
+    *t->pprev = t->next;
+    if(t->next) t->next->pprev = t->pprev;
+    t->pprev = NULL;
+}
+
+/* 按距离 wheel_ticks 的远近选层，已过期的放进当前槽 */
+static void internal_add(struct timer* t)
+{
+    uint32_t expires = t->expires;
+    uint32_t delta = expires - wheel_ticks;
+    struct timer** slot;
+
+    if((int32_t)delta < 0) {
+        slot = &tv1[wheel_ticks & TVR_MASK];
+    }
+    else if(delta < TVR_SIZE) {
+        slot = &tv1[expires & TVR_MASK];
+    }
+    else {
+        uint32_t level = 0;
+        while(level < TVN_LEVELS - 1 && delta >= (1U << (TVR_BITS + (level + 1) * TVN_BITS))) {
+            level++;
+        }
+        slot = &tvn[level][TVN_INDEX(level, expires)];
+    }
+
+    list_add(slot, t);
+}
+
+/* 把一个高层槽里的定时器按新的距离重新放置，返回槽号，0 表示该层也转完一圈 */
+static uint32_t cascade(uint32_t level, uint32_t index)
+{
+    struct timer* t = tvn[level][index];
+    tvn[level][index] = NULL;
+
+    while(t) {
+        struct timer* next = t->next;
+        internal_add(t);
+        cascaded++;
+        t = next;
+    }
+
+    return index;
+}
+
+/* 可在任何上下文调用；重复添加等同于 timer_mod。fn 为空返回 0 */
+int timer_add(struct timer* t, uint32_t expires, void (*fn)(void* arg), void* arg)
+{
+    if(!fn) return 0;
+
+    uint32_t flags = irq_save();
+    if(t->pprev) {
+        list_del(t);
+        pending--;
+    }
+
+    // 时间轮空着时 wheel_ticks 停在原地，先对齐到当前时间
+    if(0 == pending) wheel_ticks = get_ticks();
+
+    t->expires = expires;
+    t->fn = fn;
+    t->arg = arg;
+    internal_add(t);
+
+    added++;
+    if(++pending > max_pending) max_pending = pending;
+    irq_restore(flags);
+
+    return 1;
+}
+
+/* 修改到期时间，返回修改前是否在等待 */
+int timer_mod(struct timer* t, uint32_t expires)
+{
+    uint32_t flags = irq_save();
+    int was_pending = t->pprev != NULL;
+    timer_add(t, expires, t->fn, t->arg);
+    irq_restore(flags);
+
+    return was_pending;
+}
+
+/* 返回删除前是否在等待；已经开始执行的回调不受影响 */
+int timer_del(struct timer* t)
+{
+    uint32_t flags = irq_save();
+    int was_pending = t->pprev != NULL;
+    if(was_pending) {
+        list_del(t);
+        pending--;
+    }
+    irq_restore(flags);
+
+    return was_pending;
+}
+
+bool timer_pending(const struct timer* t)
+{
+    return t->pprev != NULL;
+}
+
+/* 时钟中断中调用：有定时器时把到期处理交给下半部 */
+void timer_wheel_tick(void)
+{
+    if(pending) tasklet_hi_schedule(&timer_tasklet);
+}
+
+/* 下半部：逐 tick 追到当前时间，到期的定时器先摘到本地链表，开中断逐个回调 */
+static void run_timers(void* data)
+{
+    (void)data;
+    uint32_t now = get_ticks();
+    uint32_t flags = irq_save();
+
+    while(pending && (int32_t)(now - wheel_ticks) >= 0)
+    {
+        uint32_t index = wheel_ticks & TVR_MASK;
+
+        // 第一层转完一圈，从下一层取一个槽打散下来，必要时逐层进位
+        if(0 == index) {
+            for(uint32_t level = 0; level < TVN_LEVELS; level++) {
+                if(cascade(level, TVN_INDEX(level, wheel_ticks))) break;
+            }
+        }
+        wheel_ticks++;
+
+        struct timer* list = NULL;
+        if(tv1[index]) {
+            list = tv1[index];
+            list->pprev = &list;
+            tv1[index] = NULL;
+        }
+
+        // 本地链表上的定时器仍算等待中，回调前 timer_del 可以把它摘掉
+        while(list) {
+            struct timer* t = list;
+            list_del(t);
+            pending--;
+            expired++;
+
+            void (*fn)(void*) = t->fn;
+            void* arg = t->arg;
+            irq_restore(flags);
+            fn(arg);
+            flags = irq_save();
+        }
+    }
+
+    irq_restore(flags);
+}
+
+/* 距离时间轮下一次有工作（第一层槽非空或需要打散高层）还有多少 tick，最多 max */
+uint32_t timer_next_event(uint32_t max)
+{
+    uint32_t flags = irq_save();
+    uint32_t now = get_ticks();
+    uint32_t next = max;
+
+    if(pending) {
+        for(uint32_t tick = wheel_ticks; (int32_t)(tick - now) < (int32_t)max; tick++) {
+            if(tv1[tick & TVR_MASK] || 0 == (tick & TVR_MASK)) {
+                next = (int32_t)(tick - now) > 0 ? tick - now : 0;
+                break;
+            }
+        }
+    }
+
+    irq_restore(flags);
+    return next;
+}
+
+void timer_wheel_stats(void)
+{
+    printf("\n=== Timer Wheel (tick %d) ===\n", wheel_ticks);
+    printf("Pending: %d (max %d), added %d, expired %d, cascaded %d\n",
+           pending, max_pending, added, expired, cascaded);
+}
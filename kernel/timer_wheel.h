@@ -0,0 +1,36 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include "types.h"
+
+/* 分层时间轮：第一层 256 个槽按 tick 精确到期，其余四层各 64 个槽，
+ * 每层覆盖上一层的 64 倍范围，第一层转完一圈时把下一层的一个槽打散下来 */
+#define TVR_BITS        8
+#define TVN_BITS        6
+#define TVR_SIZE        (1 << TVR_BITS)
+#define TVN_SIZE        (1 << TVN_BITS)
+#define TVR_MASK        (TVR_SIZE - 1)
+#define TVN_MASK        (TVN_SIZE - 1)
+#define TVN_LEVELS      4
+
+/* 定时器结构体由调用者提供，首次使用前须清零；回调前已从时间轮摘下，回调可以重新添加自己 */
+struct timer
+{
+    uint32_t expires;           // 到期的 tick
+    void (*fn)(void* arg);
+    void* arg;
+
+    struct timer* next;
+    struct timer** pprev;       // 指向前一项的 next 或槽头，NULL 表示未挂入
+};
+
+int timer_add(struct timer* t, uint32_t expires, void (*fn)(void* arg), void* arg);
+int timer_mod(struct timer* t, uint32_t expires);
+int timer_del(struct timer* t);
+bool timer_pending(const struct timer* t);
+
+void timer_wheel_tick(void);
+uint32_t timer_next_event(uint32_t max);
+void timer_wheel_stats(void);
+
+#endif
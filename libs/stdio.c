@@ -15,6 +15,34 @@ void memset(void* ptr, uint8_t value, uint32_t size)
     }
 }
 
+void memcpy(void* dest, const void* src, uint32_t size)
+{
+    uint8_t* d = (uint8_t*)dest;
+    const uint8_t* s = (const uint8_t*)src;
+
+    // 先按 4 字节拷贝，再处理剩余字节
+    for(; size >= 4; size -= 4, d += 4, s += 4)
+    {
+        *(uint32_t*)d = *(const uint32_t*)s;
+    }
+    for(uint32_t i = 0; i < size; i++)
+    {
+        d[i] = s[i];
+    }
+}
+
+int memcmp(const void* s1, const void* s2, uint32_t size)
+{
+    const uint8_t* a = (const uint8_t*)s1;
+    const uint8_t* b = (const uint8_t*)s2;
+
+    for(uint32_t i = 0; i < size; i++)
+    {
+        if(a[i] != b[i]) return a[i] - b[i];
+    }
+    return 0;
+}
+
 int printf(const char* format, ...)
 {
     char buffer[256];
@@ -71,16 +99,42 @@ static void format_string(char* dest, const char* src, int width, format_flags f
     dest[width > len ? width : len] = '\0';
 }
 
-static void format_number(char* dest, int num, int base, int width, format_flags flags) {
-    char num_buf[32];
-    itoa(num, num_buf, base);
+/* 无符号数按 base 转换为字符串 */
+static void utoa(uint32_t value, char* str, int base)
+{
+    char tmp[33];
+    int len = 0;
+
+    do {
+        tmp[len++] = "0123456789abcdefghijklmnopqrstuvwxyz"[value % base];
+        value /= base;
+    } while (value);
+
+    while (len) {
+        *str++ = tmp[--len];
+    }
+    *str = '\0';
+}
+
+static void format_number(char* dest, uint32_t num, int base, bool is_signed,
+                          int width, format_flags flags) {
+    char num_buf[34];
+    if (is_signed) itoa((int)num, num_buf, base);
+    else utoa(num, num_buf, base);
+
+    // 补零时负号要放在零的前面
+    if ((flags & FLAG_ZERO) && !(flags & FLAG_LEFT) && '-' == num_buf[0]) {
+        *dest++ = '-';
+        format_string(dest, num_buf + 1, width > 1 ? width - 1 : 0, flags);
+        return;
+    }
+
     format_string(dest, num_buf, width, flags);
 }
 
 int vsprintf(char* buffer, const char* format, va_list args)
 {
     char* ptr = buffer;
-    char num_buffer[32];
 
     while (*format)
     {
@@ -107,26 +161,22 @@ int vsprintf(char* buffer, const char* format, va_list args)
             case 'd':
             case 'i':{
                 int num = va_arg(args, int);
-                format_number(num_buffer, num, 10, width, flags);
-                // itoa(int_arg, num_buffer, 10);
-                strcpy(ptr, num_buffer);
-                ptr += strlen(num_buffer);
+                format_number(ptr, num, 10, true, width, flags);
+                ptr += strlen(ptr);
                 break;
             }
 
             case 'u':{
                 unsigned int num = va_arg(args, unsigned int);
-                format_number(num_buffer, num, 10, width, flags);
-                strcpy(ptr, num_buffer);
-                ptr += strlen(num_buffer);
+                format_number(ptr, num, 10, false, width, flags);
+                ptr += strlen(ptr);
                 break;
             }
             case 'x':
             case 'X':{
                 unsigned int num = va_arg(args, unsigned int);
-                format_number(num_buffer, num, 16, width, flags);
-                strcpy(ptr, num_buffer);
-                ptr += strlen(num_buffer);
+                format_number(ptr, num, 16, false, width, flags);
+                ptr += strlen(ptr);
                 break;
             }
             case 'c':
@@ -135,9 +185,8 @@ int vsprintf(char* buffer, const char* format, va_list args)
 
             case 's':
                 char* str = va_arg(args, char*);
-                format_string(num_buffer, str ? str : "(null)", width, flags);
-                strcpy(ptr, num_buffer);
-                ptr += strlen(num_buffer);
+                format_string(ptr, str ? str : "(null)", width, flags);
+                ptr += strlen(ptr);
                 break;
 
             case '%':
@@ -163,34 +212,14 @@ int vsprintf(char* buffer, const char* format, va_list args)
 
 void itoa(int value, char* str, int base)
 {
-    char* ptr = str;
-    char* ptr1 = str;
-
-    char tmp_char;
-    int tmp_value;
-
-    if(0 == value) {
-        *ptr++ = '\0';
-        *ptr = '\0';
+    // 只有十进制输出负号，其他进制按无符号数处理
+    if(value < 0 && 10 == base) {
+        *str++ = '-';
+        utoa(0U - (uint32_t)value, str, base);
         return;
     }
 
-    while (value)
-    {
-        tmp_value = value;
-        value /= base;
-        *ptr++ = "zyxwvutsrqponmlkjihgfedcba9876543210123456789abcdefghijklmnopqrstuvwxyz"[35 + (tmp_value - value * base)];
-            
-    }
-
-    *ptr-- = '\0';
-
-    while (ptr1 < ptr)
-    {
-        tmp_char = *ptr;
-        *ptr-- = *ptr1;
-        *ptr1++ = tmp_char;
-    }
+    utoa((uint32_t)value, str, base);
 }
 
 
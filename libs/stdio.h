@@ -17,6 +17,8 @@ char* strcpy(char* dest, const char* src);
 size_t strlen(const char* str);
 int strcmp(const char* s1, const char* s2);
 void memset(void* ptr, uint8_t value, uint32_t size);
+void memcpy(void* dest, const void* src, uint32_t size);
+int memcmp(const void* s1, const void* s2, uint32_t size);
 
 void test_stdio_functions(void);
 #endif
\ No newline at end of file
@@ -0,0 +1,27 @@
+#ifndef HOST_H
+#define HOST_H
+
+#include "types.h"
+
+/* 宿主机基准程序的运行环境：32 位 Linux 静态程序，不链接 libc，直接使用系统调用。
+ * 物理内存用 mmap 的匿名内存模拟，地址与内核中的恒等映射一致 */
+
+/* 假物理内存从 HOST_LOW_MEM_START 映射到 KERNEL_MEMORY_MB，E820 表放在其中（见 Makefile） */
+#define HOST_LOW_MEM_START  0x10000
+#define HOST_MEM_END        (KERNEL_MEMORY_MB * 1024 * 1024)
+
+#define HOST_STDOUT     1
+#define HOST_STDERR     2
+
+void host_write(int fd, const char* str, uint32_t len);
+void host_exit(int code);
+
+/* 基准结果（CSV）写到标准输出，内核模块自身的打印写到标准错误 */
+void host_printf(const char* format, ...);
+
+int host_main(void);
+
+/* 时钟替身：get_ticks 返回这里设置的值 */
+void host_set_ticks(uint32_t ticks);
+
+#endif
@@ -0,0 +1,791 @@
+#include "host.h"
+#include "memory.h"
+#include "buddy.h"
+#include "heap.h"
+#include "stdio.h"
+#include "cpu.h"
+#include "softirq.h"
+#include "timer_wheel.h"
+
+/* 宿主机基准：每个基准重复 BENCH_REPEAT 次，输出每次操作周期数的最小值和中位数。
+ * 随机数种子固定，两次运行之间可以直接对比 */
+#define BENCH_REPEAT    7
+#define BENCH_SEED      0x2545F491
+
+#define SMALL_LIVE      1024
+#define LARGE_LIVE      64
+#define APPEND_STEPS    1024
+#define SPARSE_FRAMES   4096
+#define SPARSE_STRIDE   64
+#define BULK_FRAMES     64
+
+#define CHECK_SLOTS     512
+#define CHECK_OPS       20000
+#define FRAME_SLOTS     256
+
+#define TIMER_COUNT     20000
+#define TIMER_PERIOD    997
+#define TIMER_START     0xFFFF0000  // 检查过程中跨过 tick 回绕
+
+#define HOST_FRAMES     ((HOST_MEM_END - USABLE_MEM_START) / PAGE_SIZE)
+
+static uint32_t rand_state;
+
+static uint32_t rand_next(void)
+{
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+static uint32_t rand_range(uint32_t low, uint32_t high)
+{
+    return low + rand_next() % (high - low + 1);
+}
+
+/* ---------------- 基准 ---------------- */
+
+struct bench
+{
+    const char* suite;
+    const char* name;
+    uint32_t ops;
+    void (*setup)(void);
+    void (*run)(uint32_t ops);
+    void (*teardown)(void);
+};
+
+static void* live[SMALL_LIVE];
+static uint32_t frames[SPARSE_FRAMES];
+static char format_buffer[512];
+static char long_string[300];
+
+static void heap_pair_run(uint32_t ops)
+{
+    for(uint32_t i = 0; i < ops; i++) {
+        kfree(kmalloc(32));
+    }
+}
+
+static void live_fill(uint32_t count, uint32_t low, uint32_t high)
+{
+    for(uint32_t i = 0; i < count; i++) {
+        live[i] = kmalloc(rand_range(low, high));
+    }
+}
+
+static void live_release(void)
+{
+    for(uint32_t i = 0; i < SMALL_LIVE; i++) {
+        kfree(live[i]);
+        live[i] = NULL;
+    }
+}
+
+static void small_mix_setup(void)
+{
+    live_fill(SMALL_LIVE, 8, 256);
+}
+
+static void small_mix_run(uint32_t ops)
+{
+    for(uint32_t i = 0; i < ops; i++) {
+        uint32_t slot = rand_next() % SMALL_LIVE;
+        kfree(live[slot]);
+        live[slot] = kmalloc(rand_range(8, 256));
+    }
+}
+
+static void large_mix_setup(void)
+{
+    live_fill(LARGE_LIVE, 4096, 65536);
+}
+
+static void large_mix_run(uint32_t ops)
+{
+    for(uint32_t i = 0; i < ops; i++) {
+        uint32_t slot = rand_next() % LARGE_LIVE;
+        kfree(live[slot]);
+        live[slot] = kmalloc(rand_range(4096, 65536));
+    }
+}
+
+static void append_run(uint32_t ops)
+{
+    void* buffer = NULL;
+    for(uint32_t i = 0; i < ops; i++) {
+        buffer = krealloc(buffer, (i % APPEND_STEPS + 1) * 64);
+        if(APPEND_STEPS - 1 == i % APPEND_STEPS) {
+            kfree(buffer);
+            buffer = NULL;
+        }
+    }
+    kfree(buffer);
+}
+
+static void frame_pair_run(uint32_t ops)
+{
+    for(uint32_t i = 0; i < ops; i++) {
+        free_frame(allocate_frame());
+    }
+}
+
+/* 预先占满一段帧，每隔 SPARSE_STRIDE 个留一个空洞，测量跨满字扫描的代价 */
+static void sparse_setup(void)
+{
+    allocate_frames_bulk(SPARSE_FRAMES, frames);
+    for(uint32_t i = 0; i < SPARSE_FRAMES; i += SPARSE_STRIDE) {
+        free_frame(frames[i]);
+    }
+}
+
+static void sparse_run(uint32_t ops)
+{
+    uint32_t holes[SPARSE_FRAMES / SPARSE_STRIDE];
+    uint32_t count = SPARSE_FRAMES / SPARSE_STRIDE;
+
+    for(uint32_t done = 0; done < ops; done += count) {
+        for(uint32_t i = 0; i < count; i++) holes[i] = allocate_frame();
+        for(uint32_t i = 0; i < count; i++) free_frame(holes[i]);
+    }
+}
+
+static void sparse_teardown(void)
+{
+    for(uint32_t i = 0; i < SPARSE_FRAMES; i++) {
+        if(i % SPARSE_STRIDE) free_frame(frames[i]);
+    }
+}
+
+static void bulk_run(uint32_t ops)
+{
+    for(uint32_t done = 0; done < ops; done += BULK_FRAMES) {
+        allocate_frames_bulk(BULK_FRAMES, frames);
+        free_frames_bulk(BULK_FRAMES, frames);
+    }
+}
+
+static void buddy_order0_run(uint32_t ops)
+{
+    for(uint32_t i = 0; i < ops; i++) {
+        free_pages(alloc_pages(0), 0);
+    }
+}
+
+static void buddy_order4_run(uint32_t ops)
+{
+    for(uint32_t i = 0; i < ops; i++) {
+        free_pages(alloc_pages(4), 4);
+    }
+}
+
+static void sprintf_int_run(uint32_t ops)
+{
+    for(uint32_t i = 0; i < ops; i++) {
+        sprintf(format_buffer, "%d", (int)rand_next());
+    }
+}
+
+static void sprintf_hex_run(uint32_t ops)
+{
+    for(uint32_t i = 0; i < ops; i++) {
+        sprintf(format_buffer, "%08x", rand_next());
+    }
+}
+
+static void sprintf_string_run(uint32_t ops)
+{
+    for(uint32_t i = 0; i < ops; i++) {
+        sprintf(format_buffer, "%s", long_string);
+    }
+}
+
+static void sprintf_mixed_run(uint32_t ops)
+{
+    for(uint32_t i = 0; i < ops; i++) {
+        sprintf(format_buffer, "frame %d at 0x%x [%-8s] %u%%", i, rand_next(), "usable", i % 100);
+    }
+}
+
+/* 大量等待中的定时器下的插入/修改/删除 */
+static struct timer bench_timers[TIMER_COUNT];
+
+static void bench_timer_fn(void* arg)
+{
+    (void)arg;
+}
+
+static void timer_fill_setup(void)
+{
+    host_set_ticks(0);
+    for(uint32_t i = 0; i < TIMER_COUNT; i++) {
+        timer_add(&bench_timers[i], rand_range(1, 1 << 20), bench_timer_fn, NULL);
+    }
+}
+
+static void timer_fill_teardown(void)
+{
+    for(uint32_t i = 0; i < TIMER_COUNT; i++) timer_del(&bench_timers[i]);
+}
+
+static void timer_mod_run(uint32_t ops)
+{
+    for(uint32_t i = 0; i < ops; i++) {
+        timer_mod(&bench_timers[rand_next() % TIMER_COUNT], rand_range(1, 1 << 20));
+    }
+}
+
+static void timer_del_add_run(uint32_t ops)
+{
+    for(uint32_t i = 0; i < ops; i++) {
+        struct timer* t = &bench_timers[rand_next() % TIMER_COUNT];
+        timer_del(t);
+        timer_add(t, rand_range(1, 1 << 20), bench_timer_fn, NULL);
+    }
+}
+
+static const struct bench benches[] = {
+    {"heap",  "kmalloc_kfree_32",   100000, NULL,            heap_pair_run,     NULL},
+    {"heap",  "small_mix_1024",     100000, small_mix_setup, small_mix_run,     live_release},
+    {"heap",  "large_mix_64",       10000,  large_mix_setup, large_mix_run,     live_release},
+    {"heap",  "krealloc_append_64", 16384,  NULL,            append_run,        NULL},
+    {"frame", "alloc_free",         100000, NULL,            frame_pair_run,    NULL},
+    {"frame", "sparse_holes",       16384,  sparse_setup,    sparse_run,        sparse_teardown},
+    {"frame", "bulk_64",            16384,  NULL,            bulk_run,          NULL},
+    {"buddy", "order_0",            100000, NULL,            buddy_order0_run,  NULL},
+    {"buddy", "order_4",            100000, NULL,            buddy_order4_run,  NULL},
+    {"stdio", "sprintf_d",          100000, NULL,            sprintf_int_run,   NULL},
+    {"stdio", "sprintf_08x",        100000, NULL,            sprintf_hex_run,   NULL},
+    {"stdio", "sprintf_long_s",     20000,  NULL,            sprintf_string_run, NULL},
+    {"stdio", "sprintf_mixed",      50000,  NULL,            sprintf_mixed_run, NULL},
+    {"timer", "mod_20k_pending",    100000, timer_fill_setup, timer_mod_run,    timer_fill_teardown},
+    {"timer", "del_add_20k_pending", 100000, timer_fill_setup, timer_del_add_run, timer_fill_teardown},
+};
+
+static void run_bench(const struct bench* bench)
+{
+    uint32_t samples[BENCH_REPEAT];
+
+    for(uint32_t round = 0; round < BENCH_REPEAT; round++)
+    {
+        rand_state = BENCH_SEED;
+        if(bench->setup) bench->setup();
+
+        uint64_t start = rdtsc();
+        bench->run(bench->ops);
+        uint64_t cycles = rdtsc() - start;
+
+        if(bench->teardown) bench->teardown();
+
+        // 插入排序，结束后 samples 有序
+        uint32_t value = (uint32_t)div_u64(cycles, bench->ops);
+        uint32_t i = round;
+        for(; i > 0 && samples[i - 1] > value; i--) samples[i] = samples[i - 1];
+        samples[i] = value;
+    }
+
+    host_printf("%s,%s,%u,%u,%u\n", bench->suite, bench->name, bench->ops,
+                samples[0], samples[BENCH_REPEAT / 2]);
+}
+
+/* ---------------- 一致性检查 ---------------- */
+
+static uint32_t checks = 0;
+static uint32_t failures = 0;
+
+static void check(bool ok, const char* what, uint32_t value)
+{
+    checks++;
+    if(!ok) {
+        failures++;
+        if(failures <= 20) printf("CHECK FAILED: %s (0x%x)\n", what, value);
+    }
+}
+
+static void check_heap_totals(void)
+{
+    uint32_t used, total;
+    struct heap_instrumentation stats;
+
+    heap_usage(&used, &total);
+    heap_get_instrumentation(&stats);
+    check(used + stats.free_bytes == total, "heap used + free != total", used + stats.free_bytes);
+}
+
+struct check_slot
+{
+    uint8_t* ptr;
+    uint32_t size;
+    uint8_t pattern;
+};
+
+static struct check_slot slots[CHECK_SLOTS];
+
+static void slot_fill(struct check_slot* slot, uint32_t size)
+{
+    slot->size = size;
+    slot->pattern = (uint8_t)rand_next();
+    memset(slot->ptr, slot->pattern, size);
+    check(ksize(slot->ptr) >= size, "ksize smaller than request", (uint32_t)slot->ptr);
+}
+
+static void slot_verify(const struct check_slot* slot)
+{
+    for(uint32_t i = 0; i < slot->size; i++) {
+        if(slot->ptr[i] != slot->pattern) {
+            check(false, "heap payload corrupted", (uint32_t)(slot->ptr + i));
+            return;
+        }
+    }
+}
+
+/* 随机混合 kmalloc/kcalloc/kmalloc_aligned/krealloc/kfree，校验数据与统计 */
+static void check_heap(void)
+{
+    rand_state = BENCH_SEED;
+    memset(slots, 0, sizeof(slots));
+
+    for(uint32_t op = 0; op < CHECK_OPS; op++)
+    {
+        struct check_slot* slot = &slots[rand_next() % CHECK_SLOTS];
+        uint32_t size = (rand_next() & 3) ? rand_range(1, 512) : rand_range(513, 32768);
+
+        if(slot->ptr) slot_verify(slot);
+
+        switch(rand_next() % 5)
+        {
+        case 0:
+            kfree(slot->ptr);
+            slot->ptr = NULL;
+            break;
+
+        case 1:
+            kfree(slot->ptr);
+            slot->ptr = (uint8_t*)kcalloc(1, size);
+            check(NULL != slot->ptr, "kcalloc failed", size);
+            for(uint32_t i = 0; slot->ptr && i < size; i++) {
+                if(slot->ptr[i]) {
+                    check(false, "kcalloc memory not zeroed", (uint32_t)(slot->ptr + i));
+                    break;
+                }
+            }
+            break;
+
+        case 2:{
+            uint32_t align = 16U << (rand_next() % 9);
+            kfree(slot->ptr);
+            slot->ptr = (uint8_t*)kmalloc_aligned(size, align);
+            check(slot->ptr && !((uint32_t)slot->ptr & (align - 1)), "kmalloc_aligned misaligned",
+                  (uint32_t)slot->ptr);
+            break;
+        }
+
+        case 3:{
+            // krealloc 必须保留较短一方的内容
+            uint32_t keep = slot->ptr ? (size < slot->size ? size : slot->size) : 0;
+            slot->ptr = (uint8_t*)krealloc(slot->ptr, size);
+            check(NULL != slot->ptr, "krealloc failed", size);
+            slot->size = keep;
+            if(slot->ptr) slot_verify(slot);
+            break;
+        }
+
+        default:
+            kfree(slot->ptr);
+            slot->ptr = (uint8_t*)kmalloc(size);
+            check(NULL != slot->ptr, "kmalloc failed", size);
+            break;
+        }
+
+        if(slot->ptr) slot_fill(slot, size);
+        if(0 == op % 1000) check_heap_totals();
+    }
+
+    for(uint32_t i = 0; i < CHECK_SLOTS; i++) {
+        if(slots[i].ptr) slot_verify(&slots[i]);
+        kfree(slots[i].ptr);
+        slots[i].ptr = NULL;
+    }
+    check_heap_totals();
+
+    uint32_t used, total;
+    heap_usage(&used, &total);
+    // 全部释放后只剩各段的头尾开销
+    check(0 == used % HEAP_SEGMENT_OVERHEAD && used <= HEAP_MAX_SEGMENTS * HEAP_SEGMENT_OVERHEAD,
+          "heap not empty after freeing everything", used);
+}
+
+/* 比整个堆还大的单次分配只应新建一段，而不是反复扩展直到耗尽 */
+static void check_heap_expand(void)
+{
+    static const uint32_t extra[] = {0x13D620, 20 * 1024 * 1024};
+
+    for(uint32_t i = 0; i < sizeof(extra) / sizeof(extra[0]); i++) {
+        uint32_t used, total;
+        struct heap_instrumentation before, after;
+
+        heap_usage(&used, &total);
+        heap_get_instrumentation(&before);
+
+        uint32_t size = total + extra[i];
+        void* ptr = kmalloc(size);
+        heap_get_instrumentation(&after);
+
+        check(NULL != ptr, "large kmalloc failed", size);
+        check(after.expansions - before.expansions == 1, "large kmalloc expanded more than once",
+              after.expansions - before.expansions);
+
+        kfree(ptr);
+        check_heap_totals();
+
+        // 对齐分配同样只扩展一次，并计入 kmalloc 的延迟统计
+        heap_get_instrumentation(&before);
+        ptr = kmalloc_aligned(size, PAGE_SIZE);
+        heap_get_instrumentation(&after);
+
+        check(ptr && !((uint32_t)ptr & (PAGE_SIZE - 1)), "large kmalloc_aligned failed", size);
+        check(after.expansions - before.expansions == 1,
+              "large kmalloc_aligned expanded more than once", after.expansions - before.expansions);
+        check(after.alloc.calls - before.alloc.calls == 1, "kmalloc_aligned not instrumented",
+              after.alloc.calls - before.alloc.calls);
+
+        kfree(ptr);
+        check_heap_totals();
+    }
+}
+
+/* 帧分配器和伙伴系统对照影子位图：不能重复分配，也不能越界 */
+static uint8_t shadow[HOST_FRAMES];
+
+static bool shadow_claim(uint32_t addr, uint32_t pages)
+{
+    if(addr < USABLE_MEM_START || addr & (PAGE_SIZE - 1)) return false;
+
+    uint32_t index = (addr - USABLE_MEM_START) / PAGE_SIZE;
+    if(index + pages > HOST_FRAMES) return false;
+
+    for(uint32_t i = 0; i < pages; i++) {
+        if(shadow[index + i]) return false;
+    }
+    memset(&shadow[index], 1, pages);
+    return true;
+}
+
+static void shadow_release(uint32_t addr, uint32_t pages)
+{
+    memset(&shadow[(addr - USABLE_MEM_START) / PAGE_SIZE], 0, pages);
+}
+
+struct frame_slot
+{
+    uint32_t addr;
+    uint32_t pages;
+    uint32_t order;             // 伙伴块的阶，普通帧为 0xFFFFFFFF
+};
+
+static struct frame_slot frame_slots[FRAME_SLOTS];
+
+static void frame_slot_release(struct frame_slot* slot)
+{
+    if(!slot->addr) return;
+
+    if(0xFFFFFFFF == slot->order) free_frame_range(slot->addr, slot->pages);
+    else free_pages(slot->addr, slot->order);
+
+    shadow_release(slot->addr, slot->pages);
+    slot->addr = 0;
+}
+
+static void check_frames(void)
+{
+    rand_state = BENCH_SEED;
+    memset(frame_slots, 0, sizeof(frame_slots));
+
+    // 伙伴池按需从位图取页，两者合计的空闲页数守恒
+    uint32_t free_before = get_free_frames();
+    uint32_t total_before = free_before + buddy_free_pages();
+
+    for(uint32_t op = 0; op < CHECK_OPS; op++)
+    {
+        struct frame_slot* slot = &frame_slots[rand_next() % FRAME_SLOTS];
+        frame_slot_release(slot);
+
+        uint32_t flags = rand_next() & ALLOC_DMA;
+
+        switch(rand_next() % 4)
+        {
+        case 0:
+            slot->addr = alloc_frame_zone(flags);
+            slot->pages = 1;
+            slot->order = 0xFFFFFFFF;
+            break;
+
+        case 1:{
+            uint32_t count = rand_range(1, 16);
+            uint32_t align = PAGE_SIZE << (rand_next() % 4);
+            slot->addr = alloc_frame_range_zone(count, align, flags);
+            slot->pages = count;
+            slot->order = 0xFFFFFFFF;
+            check(!(slot->addr & (align - 1)), "frame range misaligned", slot->addr);
+            break;
+        }
+
+        case 2:
+            slot->order = rand_next() % 6;
+            slot->pages = 1U << slot->order;
+            slot->addr = alloc_pages(slot->order);
+            check(!(slot->addr & (slot->pages * PAGE_SIZE - 1)), "buddy block misaligned", slot->addr);
+            break;
+
+        default:
+            break;
+        }
+
+        if(slot->addr) {
+            check(shadow_claim(slot->addr, slot->pages), "frame handed out twice", slot->addr);
+        }
+
+        // 高端内存充足时普通分配不能落到 DMA 区，DMA 分配必须整体位于 16MB 以下
+        if(slot->addr && 0xFFFFFFFF == slot->order) {
+            if(flags & ALLOC_DMA) {
+                check(slot->addr + slot->pages * PAGE_SIZE <= ZONE_DMA_LIMIT, "DMA frame above 16MB", slot->addr);
+            }
+            else {
+                check(slot->addr >= ZONE_DMA_LIMIT, "normal frame taken from DMA zone", slot->addr);
+            }
+        }
+        check(get_zone_free_frames(ZONE_DMA) + get_zone_free_frames(ZONE_NORMAL) == get_free_frames(),
+              "zone free counts out of sync", get_free_frames());
+    }
+
+    // 批量接口单独检查
+    uint32_t batch[BULK_FRAMES];
+    check(BULK_FRAMES == allocate_frames_bulk(BULK_FRAMES, batch), "bulk allocation failed", 0);
+    for(uint32_t i = 0; i < BULK_FRAMES; i++) {
+        check(shadow_claim(batch[i], 1), "bulk frame handed out twice", batch[i]);
+    }
+    free_frames_bulk(BULK_FRAMES, batch);
+    for(uint32_t i = 0; i < BULK_FRAMES; i++) shadow_release(batch[i], 1);
+
+    for(uint32_t i = 0; i < FRAME_SLOTS; i++) {
+        frame_slot_release(&frame_slots[i]);
+    }
+
+    check(get_free_frames() + buddy_free_pages() == total_before, "free frame count drifted",
+          get_free_frames() + buddy_free_pages());
+    // 全部释放后池只保留最后一个空闲块，其余整块都已交还位图
+    check(buddy_free_pages() <= BUDDY_MAX_PAGES, "buddy pool not released", buddy_free_pages());
+
+    // 伙伴块的重复释放：块头、块中间、以及包含已空闲块的更大范围都要拒绝
+    uint32_t block = alloc_pages(2);
+    uint32_t pair = alloc_pages(1);
+    uint32_t before = buddy_free_pages();
+    free_pages(block, 2);
+    free_pages(block, 2);
+    free_pages(block + PAGE_SIZE, 0);
+    free_pages(block, 3);
+    free_pages(pair, 3);
+    check(buddy_free_pages() == before + 4, "buddy double free accepted", buddy_free_pages());
+    free_pages(pair, 1);
+
+    // 保留帧和伙伴池中的帧不能经 free_frame 放回位图
+    uint32_t owned = alloc_pages(0);
+    free_before = get_free_frames();
+    free_frame(HOST_MEM_END - PAGE_SIZE);
+    free_frame(owned);
+    check(get_free_frames() == free_before, "free_frame accepted reserved or buddy frame",
+          get_free_frames());
+    free_pages(owned, 0);
+    free_before = get_free_frames();
+
+    // 先弄脏一批帧再释放，预清零池补充时会重新拿到它们
+    uint32_t zeroed[ZERO_POOL_BATCH];
+    allocate_frames_bulk(ZERO_POOL_BATCH, zeroed);
+    for(uint32_t i = 0; i < ZERO_POOL_BATCH; i++) memset((void*)zeroed[i], 0xCC, PAGE_SIZE);
+    free_frames_bulk(ZERO_POOL_BATCH, zeroed);
+
+    refill_zero_pool();
+    for(uint32_t i = 0; i < ZERO_POOL_BATCH; i++) {
+        zeroed[i] = allocate_zeroed_frame();
+        for(uint32_t j = 0; j < PAGE_SIZE / sizeof(uint32_t); j++) {
+            if(((uint32_t*)zeroed[i])[j]) {
+                check(false, "zeroed frame not zero", zeroed[i]);
+                break;
+            }
+        }
+    }
+    free_frames_bulk(ZERO_POOL_BATCH, zeroed);
+    check(get_free_frames() == free_before, "zero pool leaked frames", get_free_frames());
+}
+
+/* 独立实现的参考格式化，用来对照 vsprintf */
+static void ref_format(char* out, uint32_t value, char conv, uint32_t width, bool zero, bool left)
+{
+    char digits[16];
+    uint32_t len = 0;
+    bool negative = ('d' == conv && (int)value < 0);
+    uint32_t base = ('x' == conv) ? 16 : 10;
+    uint32_t magnitude = negative ? 0U - value : value;
+
+    do {
+        digits[len++] = "0123456789abcdef"[magnitude % base];
+        magnitude /= base;
+    } while(magnitude);
+
+    uint32_t body = len + (negative ? 1 : 0);
+    uint32_t pad = width > body ? width - body : 0;
+
+    if(!left && !zero) while(pad) { *out++ = ' '; pad--; }
+    if(negative) *out++ = '-';
+    if(!left && zero) while(pad) { *out++ = '0'; pad--; }
+    while(len) *out++ = digits[--len];
+    while(pad) { *out++ = ' '; pad--; }
+    *out = '\0';
+}
+
+static void check_format(uint32_t value, char conv, uint32_t width, bool zero, bool left)
+{
+    char format[8];
+    char expected[48];
+    char* f = format;
+
+    *f++ = '%';
+    if(left) *f++ = '-';
+    if(zero) *f++ = '0';
+    if(width) *f++ = '0' + width;
+    *f++ = conv;
+    *f = '\0';
+
+    ref_format(expected, value, conv, width, zero, left);
+    sprintf(format_buffer, format, value);
+    check(0 == strcmp(format_buffer, expected), "sprintf output mismatch", value);
+}
+
+/* 时间轮：按 timer_next_event 跳着推进时钟（模拟动态时钟），
+ * 每个定时器必须恰好在到期 tick 回调一次，删除的不回调 */
+struct timer_check
+{
+    struct timer timer;
+    uint32_t expires;
+    uint32_t fired;
+    uint32_t fired_at;
+    bool deleted;
+    bool periodic;
+};
+
+static struct timer_check timer_checks[TIMER_COUNT];
+static uint32_t check_ticks;
+
+static void check_timer_fn(void* arg)
+{
+    struct timer_check* c = arg;
+    c->fired++;
+    c->fired_at = check_ticks;
+
+    check(!c->deleted, "deleted timer fired", c->expires);
+    check(check_ticks == c->expires, "timer fired at wrong tick", check_ticks - c->expires);
+
+    // 周期定时器在回调里重新添加自己
+    if(c->periodic && c->fired < 5) {
+        c->expires += TIMER_PERIOD;
+        timer_add(&c->timer, c->expires, check_timer_fn, c);
+    }
+}
+
+static void check_timers(void)
+{
+    rand_state = BENCH_SEED;
+    check_ticks = TIMER_START;
+    host_set_ticks(check_ticks);
+    memset(timer_checks, 0, sizeof(timer_checks));
+
+    uint32_t last = 0;
+    for(uint32_t i = 0; i < TIMER_COUNT; i++)
+    {
+        struct timer_check* c = &timer_checks[i];
+        uint32_t range = (i % 3 == 0) ? 300 : (i % 3 == 1) ? 20000 : 2000000;
+        c->expires = check_ticks + rand_range(1, range);
+        c->periodic = (i % 101 == 0);
+        check(timer_add(&c->timer, c->expires, check_timer_fn, c), "timer_add failed", i);
+    }
+
+    // 删掉四分之一，再改掉四分之一的到期时间
+    for(uint32_t i = 0; i < TIMER_COUNT; i += 4) {
+        check(timer_del(&timer_checks[i].timer), "timer_del of pending timer returned 0", i);
+        check(!timer_del(&timer_checks[i].timer), "second timer_del returned 1", i);
+        timer_checks[i].deleted = true;
+    }
+    for(uint32_t i = 1; i < TIMER_COUNT; i += 4) {
+        timer_checks[i].expires = check_ticks + rand_range(1, 300000);
+        check(timer_mod(&timer_checks[i].timer, timer_checks[i].expires), "timer_mod of pending timer returned 0", i);
+    }
+
+    for(uint32_t i = 0; i < TIMER_COUNT; i++) {
+        uint32_t end = timer_checks[i].expires + (timer_checks[i].periodic ? 5 * TIMER_PERIOD : 0);
+        if(end - TIMER_START > last - TIMER_START) last = end;
+    }
+
+    // 中断里只在有定时器时排队下半部；这里每次都按下一个事件跳到目标 tick
+    while(check_ticks - TIMER_START <= last - TIMER_START) {
+        uint32_t step = timer_next_event(100);
+        check_ticks += step ? step : 1;
+        host_set_ticks(check_ticks);
+        timer_wheel_tick();
+        run_deferred_work(0xFFFFFFFF);
+    }
+
+    for(uint32_t i = 0; i < TIMER_COUNT; i++) {
+        const struct timer_check* c = &timer_checks[i];
+        uint32_t want = c->deleted ? 0 : c->periodic ? 5 : 1;
+        check(c->fired == want, "timer fired wrong number of times", i);
+        check(!timer_pending(&c->timer), "timer still pending", i);
+    }
+}
+
+static void check_stdio(void)
+{
+    static const uint32_t edges[] = {0, 1, 9, 10, 0x7FFFFFFF, 0x80000000, 0xFFFFFFFF, 0xFFFFFFFE};
+    static const char convs[] = {'d', 'u', 'x'};
+
+    rand_state = BENCH_SEED;
+    for(uint32_t i = 0; i < 2000 + sizeof(edges) / sizeof(edges[0]); i++)
+    {
+        uint32_t value = i < sizeof(edges) / sizeof(edges[0]) ? edges[i] : rand_next() >> (rand_next() % 32);
+        for(uint32_t c = 0; c < sizeof(convs); c++) {
+            check_format(value, convs[c], 0, false, false);
+            check_format(value, convs[c], rand_range(1, 9), rand_next() & 1, false);
+            check_format(value, convs[c], rand_range(1, 9), false, true);
+        }
+    }
+
+    // 长字符串不能溢出内部缓冲
+    sprintf(format_buffer, "[%s]", long_string);
+    check(strlen(format_buffer) == sizeof(long_string) + 1 &&
+          '[' == format_buffer[0] && ']' == format_buffer[sizeof(long_string)],
+          "long %s formatted incorrectly", strlen(format_buffer));
+}
+
+int host_main(void)
+{
+    memory_init();
+    heap_init();
+
+    memset(long_string, 'a', sizeof(long_string) - 1);
+    long_string[sizeof(long_string) - 1] = '\0';
+
+    check_heap();
+    check_heap_expand();
+    check_frames();
+    check_stdio();
+    check_timers();
+    printf("Consistency checks: %d run, %d failed\n", checks, failures);
+    if(failures) return 1;
+
+    host_printf("suite,benchmark,ops,min_cycles_per_op,median_cycles_per_op\n");
+    for(uint32_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        run_bench(&benches[i]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,150 @@
+#include "host.h"
+#include "memory.h"
+#include "paging.h"
+#include "screen.h"
+#include "stdio.h"
+
+#define SYS_WRITE       4
+#define SYS_MMAP        90
+#define SYS_MADVISE     219
+#define SYS_EXIT_GROUP  252
+
+#define PROT_READ       0x1
+#define PROT_WRITE      0x2
+#define MAP_PRIVATE     0x02
+#define MAP_FIXED       0x10
+#define MAP_ANONYMOUS   0x20
+#define MAP_NORESERVE   0x4000
+#define MAP_FIXED_NOREPLACE 0x100000
+#define MADV_DONTNEED   4
+
+/* 入口：对齐栈后调用 host_main，返回值作为进程退出码 */
+asm(".globl _start\n"
+    "_start:\n"
+    "    xor %ebp, %ebp\n"
+    "    and $-16, %esp\n"
+    "    call host_start\n"
+    "    mov %eax, %ebx\n"
+    "    mov $252, %eax\n"
+    "    int $0x80\n");
+
+static inline int syscall3(int number, uint32_t a, uint32_t b, uint32_t c)
+{
+    int ret;
+    asm volatile("int $0x80" : "=a"(ret) : "a"(number), "b"(a), "c"(b), "d"(c) : "memory");
+    return ret;
+}
+
+/* i386 的旧 mmap 调用通过一个参数结构传递全部 6 个参数 */
+static uint32_t host_mmap(uint32_t addr, uint32_t length, uint32_t flags)
+{
+    uint32_t args[6] = {addr, length, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | flags, (uint32_t)-1, 0};
+    return (uint32_t)syscall3(SYS_MMAP, (uint32_t)args, 0, 0);
+}
+
+void host_write(int fd, const char* str, uint32_t len)
+{
+    syscall3(SYS_WRITE, fd, (uint32_t)str, len);
+}
+
+void host_exit(int code)
+{
+    syscall3(SYS_EXIT_GROUP, code, 0, 0);
+    while(1);
+}
+
+void host_printf(const char* format, ...)
+{
+    char buffer[512];
+    va_list args;
+
+    va_start(args, format);
+    int len = vsprintf(buffer, format, args);
+    va_end(args);
+
+    host_write(HOST_STDOUT, buffer, len);
+}
+
+/* 屏幕驱动替身：输出到标准错误 */
+void put_char(char c, uint8_t color)
+{
+    (void)color;
+    host_write(HOST_STDERR, &c, 1);
+}
+
+void printk(const char* str)
+{
+    host_write(HOST_STDERR, str, strlen(str));
+}
+
+void printk_color(const char* str, uint8_t color)
+{
+    (void)color;
+    printk(str);
+}
+
+/* 时钟由基准程序手动推进 */
+static uint32_t host_ticks;
+
+uint32_t get_ticks(void)
+{
+    return host_ticks;
+}
+
+void host_set_ticks(uint32_t ticks)
+{
+    host_ticks = ticks;
+}
+
+/* 按需清零区域直接用 mmap 预留，由宿主内核负责缺页和清零 */
+static struct page_fault_stats no_faults;
+
+int reserve_demand_region(uint32_t start, uint32_t size)
+{
+    return host_mmap(start, size, MAP_FIXED_NOREPLACE | MAP_NORESERVE) == start;
+}
+
+void release_demand_pages(uint32_t start, uint32_t size)
+{
+    syscall3(SYS_MADVISE, start, size, MADV_DONTNEED);
+}
+
+void get_page_fault_stats(struct page_fault_stats* stats)
+{
+    *stats = no_faults;
+}
+
+/* 映射假物理内存，并按引导程序的格式写入 E820 内存布局 */
+static int setup_fake_memory(void)
+{
+    uint32_t size = HOST_MEM_END - HOST_LOW_MEM_START;
+    if(host_mmap(HOST_LOW_MEM_START, size, MAP_FIXED_NOREPLACE) != HOST_LOW_MEM_START) {
+        printk("host: cannot map fake physical memory\n");
+        return 0;
+    }
+
+    struct memory_region* map = (struct memory_region*)MEMORY_MAP_ADDR;
+    map[0].base_addr = 0;
+    map[0].length = 0x9FC00;
+    map[0].type = E820_USABLE;
+    map[1].base_addr = 0xF0000;
+    map[1].length = 0x10000;
+    map[1].type = E820_RESERVED;
+    map[2].base_addr = USABLE_MEM_START;
+    map[2].length = HOST_MEM_END - USABLE_MEM_START;
+    map[2].type = E820_USABLE;
+    // 与可用区域末尾重叠的 ACPI 区域，像真实 BIOS 那样
+    map[3].base_addr = HOST_MEM_END - 0x10000;
+    map[3].length = 0x10000;
+    map[3].type = E820_ACPI_NVS;
+    *(uint16_t*)MEMORY_MAP_COUNT_ADDR = 4;
+
+    return 1;
+}
+
+int host_start(void)
+{
+    if(!setup_fake_memory()) return 1;
+    return host_main();
+}